@@ -0,0 +1,81 @@
+/* Barrett reduction context for BigInt */
+
+#ifndef BARRETT_CPP
+#define BARRETT_CPP
+
+#include <stdexcept>
+
+#include "BigInt.cpp"
+
+// info: precomputed Barrett reduction data for a fixed modulus M of k limbs. mu = floor(base^(2k) / M)
+//       is found with one long division; every reduction afterwards estimates the quotient with two
+//       multiplications and fixes it with at most two subtractions. unlike Montgomery it works for any
+//       positive modulus (even ones too) and keeps values in ordinary form.
+// params: modulus M, which must be positive.
+struct Barrett {
+  BigInt M;         // modulus
+  BigInt mu;        // floor(base^(2k) / M)
+  int k;            // limb count of M
+
+  Barrett():
+    k(0) {
+  }
+
+  Barrett(const BigInt& modulus):
+    M(modulus), k((int)modulus.a.size()) {
+    if (modulus.sign < 0 || modulus.isZero())
+      throw std::invalid_argument("Barrett modulus must be positive.");
+    BigInt power;
+    power.a.assign(2 * k, 0);
+    power.a.push_back(1);
+    mu = power / M;
+  }
+
+  // info: x = x mod M in place. values in [0, base^(2k)), e.g. any product of two residues, take the
+  //       barrett path; anything else falls back to a full division.
+  void reduce(BigInt& x) const {
+    if (x.sign < 0 || (int)x.a.size() > 2 * k) {
+      BigInt::modInto(x, x, M);
+      if (x.sign < 0)
+        x += M;
+      return;
+    }
+    if (BigInt::cmpAbs(x.a, M.a) < 0)
+      return;
+
+    static thread_local BigInt::limbs q(std::pmr::new_delete_resource()), t(std::pmr::new_delete_resource());
+    // q = floor(floor(x / base^(k-1)) * mu / base^(k+1)), at most 2 below the true quotient
+    q.assign(x.a.begin() + (k - 1), x.a.end());
+    BigInt::mulAbsInto(t, q, mu.a);
+    if (t.size() > (size_t)k + 1)
+      q.assign(t.begin() + (k + 1), t.end());
+    else
+      q.clear();
+
+    // x = (x - q * M) mod base^(k+1); only the low k + 1 limbs take part, the final borrow wraps
+    BigInt::mulAbsInto(t, q, M.a);
+    t.resize(k + 1, 0);
+    x.a.resize(k + 1, 0);
+    BigInt::subAbsInPlace(x.a, t);
+    x.trim();
+    while (BigInt::cmpAbs(x.a, M.a) >= 0) {
+      BigInt::subAbsInPlace(x.a, M.a);
+      x.trim();
+    }
+  }
+
+  // info: res = a * b mod M for residues a and b. res may be a or b.
+  void mulInto(BigInt& res, const BigInt& a, const BigInt& b) const {
+    BigInt::mulInto(res, a, b);
+    reduce(res);
+  }
+
+  // info: x mod M as a new value, in [0, M) for any x
+  BigInt mod(const BigInt& x) const {
+    BigInt res = x;
+    reduce(res);
+    return res;
+  }
+};
+
+#endif
@@ -0,0 +1,237 @@
+/* Schoolbook multiply kernels for BigInt limbs, with SIMD variants picked at run time */
+
+#ifndef BASECASEKERNELS_CPP
+#define BASECASEKERNELS_CPP
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "LimbVector.cpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BASECASE_X86 1
+#include <immintrin.h>
+#endif
+
+// info: one schoolbook product implementation. mul writes res[0 .. xn + yn) = x * y; res must not
+//       overlap x or y, and xn, yn > 0.
+struct BasecaseKernel {
+  const char* name;
+  void (*mul)(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn);
+};
+
+// ******************** Scalar kernel ********************
+
+inline
+void scalarBasecaseMul(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+  std::fill(res, res + yn, 0);
+  for (size_t i = 0; i < xn; i++) {
+    limb_t carry = 0;
+    for (size_t j = 0; j < yn; j++) {
+      unsigned __int128 cur = (unsigned __int128)x[i] * y[j] + res[i + j] + carry;
+      res[i + j] = (limb_t)cur;
+      carry = (limb_t)(cur >> 64);
+    }
+    res[i + yn] = carry;
+  }
+}
+
+// ******************** SIMD kernels ********************
+
+// the SIMD kernels accumulate column sums in 64-bit lanes, which bounds the operands they take in one
+// pass; longer x is cut into slices of this size and anything longer in y goes to the scalar kernel
+const size_t BASECASE_SIMD_LIMBS = 256;
+
+// info: res[0 .. n) = res + prod (accumulate) or prod, returns the carry out
+inline
+limb_t storeBasecaseProduct(limb_t* res, const limb_t* prod, size_t n, bool accumulate) {
+  if (!accumulate) {
+    std::memcpy(res, prod, n * sizeof(limb_t));
+    return 0;
+  }
+  limb_t carry = 0;
+  for (size_t i = 0; i < n; i++) {
+    unsigned __int128 cur = (unsigned __int128)res[i] + prod[i] + carry;
+    res[i] = (limb_t)cur;
+    carry = (limb_t)(cur >> 64);
+  }
+  return carry;
+}
+
+// info: mul for a kernel whose core handles xn, yn <= BASECASE_SIMD_LIMBS. x is cut into slices that
+//       core multiplies by y one after the other; after the first slice every product is added in.
+template <limb_t (*core)(limb_t*, const limb_t*, size_t, const limb_t*, size_t, bool)>
+void slicedBasecase(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+  if (xn < yn) {
+    std::swap(x, y);
+    std::swap(xn, yn);
+  }
+  if (yn > BASECASE_SIMD_LIMBS) {
+    scalarBasecaseMul(res, x, xn, y, yn);
+    return;
+  }
+  for (size_t off = 0; off < xn; off += BASECASE_SIMD_LIMBS) {
+    size_t len = std::min(BASECASE_SIMD_LIMBS, xn - off);
+    if (off > 0)   // the limbs above the previous slice's product are still unset
+      std::fill(res + off + yn, res + off + yn + len, 0);
+    limb_t carry = core(res + off, x + off, len, y, yn, off > 0);
+    for (size_t k = off + len + yn; carry && k < xn + yn; k++) {
+      res[k] += carry;
+      carry = res[k] < carry;
+    }
+  }
+}
+
+#ifdef BASECASE_X86
+
+// info: avx2 core on base 2^32 digits: _mm256_mul_epu32 forms four 32 x 32 -> 64-bit digit products,
+//       whose low halves are summed into column i + j and high halves into column i + j + 1. the two
+//       sums live in separate arrays so no store overlaps the next load.
+__attribute__((target("avx2")))
+inline
+limb_t avx2BasecaseCore(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn, bool accumulate) {
+  const size_t max_digits = 2 * BASECASE_SIMD_LIMBS;
+  alignas(32) uint64_t yd[max_digits + 4];
+  alignas(32) uint64_t lo[2 * max_digits + 4], hi[2 * max_digits + 4];
+  limb_t prod[2 * BASECASE_SIMD_LIMBS];
+
+  size_t dx = 2 * xn, dy = 2 * yn, dyp = (dy + 3) & ~(size_t)3;
+  for (size_t j = 0; j < dyp; j++)
+    yd[j] = j < dy ? (uint32_t)(y[j / 2] >> (32 * (j & 1))) : 0;
+  std::fill(lo, lo + dx + dyp, 0);
+  std::fill(hi, hi + dx + dyp, 0);
+
+  const __m256i mask = _mm256_set1_epi64x(0xffffffffLL);
+  for (size_t i = 0; i < dx; i++) {
+    uint32_t xi = (uint32_t)(x[i / 2] >> (32 * (i & 1)));
+    if (!xi)
+      continue;
+    __m256i bx = _mm256_set1_epi64x(xi);
+    for (size_t j = 0; j < dyp; j += 4) {
+      __m256i p = _mm256_mul_epu32(bx, _mm256_load_si256((const __m256i*)(yd + j)));
+      __m256i* l = (__m256i*)(lo + i + j);
+      __m256i* h = (__m256i*)(hi + i + j);
+      _mm256_storeu_si256(l, _mm256_add_epi64(_mm256_loadu_si256(l), _mm256_and_si256(p, mask)));
+      _mm256_storeu_si256(h, _mm256_add_epi64(_mm256_loadu_si256(h), _mm256_srli_epi64(p, 32)));
+    }
+  }
+
+  uint64_t carry = 0;   // column sums stay below 2^42, so a 64-bit carry never overflows
+  for (size_t c = 0; c < dx + dy; c += 2) {
+    uint64_t v0 = lo[c] + (c ? hi[c - 1] : 0) + carry;
+    uint64_t v1 = lo[c + 1] + hi[c] + (v0 >> 32);
+    prod[c / 2] = (v0 & 0xffffffff) | (v1 << 32);
+    carry = v1 >> 32;
+  }
+  return storeBasecaseProduct(res, prod, xn + yn, accumulate);
+}
+
+// info: the limbs of x as base 2^52 digits, returns the digit count
+inline
+size_t toDigits52(uint64_t* out, const limb_t* x, size_t n) {
+  size_t count = (64 * n + 51) / 52;
+  for (size_t k = 0; k < count; k++) {
+    size_t bit = 52 * k, i = bit / 64, s = bit % 64;
+    uint64_t v = x[i] >> s;
+    if (s > 12 && i + 1 < n)
+      v |= x[i + 1] << (64 - s);
+    out[k] = v & ((1ULL << 52) - 1);
+  }
+  return count;
+}
+
+// info: avx-512 ifma core on base 2^52 digits: vpmadd52luq / vpmadd52huq add the low and high 52 bits
+//       of eight digit products at once, into the column sums of i + j and i + j + 1.
+__attribute__((target("avx512f,avx512ifma")))
+inline
+limb_t ifmaBasecaseCore(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn, bool accumulate) {
+  const size_t max_digits = (64 * BASECASE_SIMD_LIMBS + 51) / 52;
+  alignas(64) uint64_t xd[max_digits], yd[max_digits + 8];
+  alignas(64) uint64_t lo[2 * max_digits + 8], hi[2 * max_digits + 8];
+  limb_t prod[2 * BASECASE_SIMD_LIMBS];
+
+  size_t dx = toDigits52(xd, x, xn), dy = toDigits52(yd, y, yn), dyp = (dy + 7) & ~(size_t)7;
+  std::fill(yd + dy, yd + dyp, 0);
+  std::fill(lo, lo + dx + dyp, 0);
+  std::fill(hi, hi + dx + dyp, 0);
+
+  for (size_t i = 0; i < dx; i++) {
+    if (!xd[i])
+      continue;
+    __m512i bx = _mm512_set1_epi64((long long)xd[i]);
+    for (size_t j = 0; j < dyp; j += 8) {
+      __m512i yv = _mm512_load_si512(yd + j);
+      _mm512_storeu_si512(lo + i + j, _mm512_madd52lo_epu64(_mm512_loadu_si512(lo + i + j), bx, yv));
+      _mm512_storeu_si512(hi + i + j, _mm512_madd52hi_epu64(_mm512_loadu_si512(hi + i + j), bx, yv));
+    }
+  }
+
+  // normalize to base 2^52 (column sums stay below 2^62) and pack the digits back into limbs
+  unsigned __int128 bits = 0;
+  int held = 0;
+  size_t out = 0;
+  uint64_t carry = 0;
+  for (size_t c = 0; c < dx + dy && out < xn + yn; c++) {
+    uint64_t v = lo[c] + (c ? hi[c - 1] : 0) + carry;
+    bits |= (unsigned __int128)(v & ((1ULL << 52) - 1)) << held;
+    held += 52;
+    carry = v >> 52;
+    if (held >= 64) {
+      prod[out++] = (limb_t)bits;
+      bits >>= 64;
+      held -= 64;
+    }
+  }
+  if (out < xn + yn)
+    prod[out++] = (limb_t)bits;
+  return storeBasecaseProduct(res, prod, xn + yn, accumulate);
+}
+
+inline
+void avx2BasecaseMul(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+  slicedBasecase<avx2BasecaseCore>(res, x, xn, y, yn);
+}
+
+inline
+void ifmaBasecaseMul(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+  slicedBasecase<ifmaBasecaseCore>(res, x, xn, y, yn);
+}
+
+#endif
+
+// ******************** Dispatch ********************
+
+// info: the kernels this CPU can run, scalar first. SIMD kernels are listed when the CPU reports the
+//       instructions; make check compares each of them with the scalar kernel.
+inline
+const std::vector<BasecaseKernel>& basecaseKernels() {
+  static const std::vector<BasecaseKernel> kernels = [] {
+    std::vector<BasecaseKernel> found = { { "scalar", scalarBasecaseMul } };
+#ifdef BASECASE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      found.push_back({ "avx2", avx2BasecaseMul });
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma"))
+      found.push_back({ "avx512ifma", ifmaBasecaseMul });
+#endif
+    return found;
+  }();
+  return kernels;
+}
+
+// info: the default kernel for BigInt's schoolbook products of its simd_basecase size and up:
+//       avx512ifma where available, scalar otherwise. avx2 has no 64 x 64-bit multiply, and its
+//       32-bit digit products lose to scalar mulx on the machines we measured. BigInt::tuneMultiplication()
+//       installs the fastest kernel it measures in the multiplication thresholds instead.
+inline
+const BasecaseKernel* basecaseKernel() {
+  static const BasecaseKernel* const kernel = [] {
+    const std::vector<BasecaseKernel>& kernels = basecaseKernels();
+    return std::strcmp(kernels.back().name, "avx512ifma") == 0 ? &kernels.back() : &kernels.front();
+  }();
+  return kernel;
+}
+
+#endif
@@ -1,20 +1,42 @@
 // This struct allows for the implementation of very large integers when writing C++ programs.
-// Struct is complete and should not be modified.
+// Magnitudes are stored as little-endian base 2^64 limbs; decimal is only used for stream I/O.
+
+#ifndef BIGINT_CPP
+#define BIGINT_CPP
 
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <string>
+#include <cstring>
+#include <stdexcept>
 #include <math.h>
+#include <stdint.h>
 #include <algorithm>
 #include <unordered_map>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <deque>
+#include <atomic>
+#include <mutex>
+
+#include "LimbVector.cpp"
+#include "BasecaseKernels.cpp"
+#include "NTT.cpp"
+
+typedef unsigned __int128 dlimb_t;   // holds the full product of two limbs
 
-const int base = 1000000000;
-const int base_digits = 9;
+const int limb_bits = 64;
+const limb_t decimal_chunk = 10000000000000000000ULL;  // largest power of 10 that fits in a limb
+const int decimal_chunk_digits = 19;
 
-// info: this struct allows one to directly work with very large numbers 
+// info: this struct allows one to directly work with very large numbers
 //       (greater than 20 digits) when writing a C++ program.
 struct BigInt {
-  std::vector<int> a;  // holds our very large number
+  typedef LimbVector limbs;
+
+  limbs a;                // holds our very large number, least significant limb first (small values stay inline)
   int sign;
 
   BigInt():
@@ -36,99 +58,81 @@ struct BigInt {
   // ******************** Operator overloading methods ********************
 
   // ----- Assignment -----
-  void operator=(const BigInt& v) {
-    sign = v.sign;
-    a = v.a;
-  }
-
+  // copies and moves are the implicit member-wise ones, so temporaries hand over their limbs
   void operator=(long long v) {
     sign = 1;
+    a.clear();
+    unsigned long long mag = (unsigned long long)v;
     if (v < 0)
-      sign = -1, v = -v;
-    for (; v > 0; v = v / base)
-      a.push_back(v % base);
+      sign = -1, mag = 0 - mag;
+    if (mag)
+      a.push_back(mag);
   }
   // ----------
 
   // ----- Arithmetic -----
   BigInt operator+(const BigInt& v) const {
+    BigInt res;
     if (sign == v.sign) {
-      BigInt res = v;
-
-      for (int i = 0, carry = 0; i < (int)std::max(a.size(), v.a.size()) || carry; ++i) {
-        if (i == (int)res.a.size())
-          res.a.push_back(0);
-        res.a[i] += carry + (i < (int)a.size() ? a[i] : 0);
-        carry = res.a[i] >= base;
-        if (carry)
-          res.a[i] -= base;
-      }
-      return res;
+      addAbs(res.a, a, v.a);
+      res.sign = sign;
     }
-    return *this - (-v);
+    else if (cmpAbs(a, v.a) >= 0) {
+      subAbs(res.a, a, v.a);
+      res.sign = sign;
+    }
+    else {
+      subAbs(res.a, v.a, a);
+      res.sign = v.sign;
+    }
+    res.trim();
+    return res;
   }
 
   BigInt operator-(const BigInt& v) const {
-    if (sign == v.sign) {
-      if (abs() >= v.abs()) {
-        BigInt res = *this;
-        for (int i = 0, carry = 0; i < (int)v.a.size() || carry; ++i) {
-          res.a[i] -= carry + (i < (int)v.a.size() ? v.a[i] : 0);
-          carry = res.a[i] < 0;
-          if (carry)
-            res.a[i] += base;
-        }
-        res.trim();
-        return res;
-      }
-      return -(v - *this);
-    }
-    return *this + (-v);
+    BigInt res = *this;
+    res -= v;
+    return res;
   }
 
   BigInt operator-() const {
     BigInt res = *this;
-    res.sign = -sign;
+    if (!res.a.empty())
+      res.sign = -sign;
     return res;
   }
 
   void operator*=(int v) {
     if (v < 0)
       sign = -sign, v = -v;
-    for (int i = 0, carry = 0; i < (int)a.size() || carry; ++i) {
-      if (i == (int)a.size())
-        a.push_back(0);
-      long long cur = a[i] * (long long)v + carry;
-      carry = (int)(cur / base);
-      a[i] = (int)(cur % base);
+    limb_t carry = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      dlimb_t cur = (dlimb_t)a[i] * (limb_t)v + carry;
+      a[i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
     }
+    if (carry)
+      a.push_back(carry);
     trim();
   }
 
   BigInt operator*(const BigInt& v) const {
-    std::vector<int> a6 = convert_base(this->a, base_digits, 6);
-    std::vector<int> b6 = convert_base(v.a, base_digits, 6);
-    vll a(a6.begin(), a6.end());
-    vll b(b6.begin(), b6.end());
-    while (a.size() < b.size())
-      a.push_back(0);
-    while (b.size() < a.size())
-      b.push_back(0);
-    while (a.size() & (a.size() - 1))
-      a.push_back(0), b.push_back(0);
-    vll c = karatsubaMultiply(a, b);
     BigInt res;
+    if (a.empty() || v.a.empty())
+      return res;
+    mulAbs(res.a, a, v.a);
     res.sign = sign * v.sign;
-    for (int i = 0, carry = 0; i < (int)c.size(); i++) {
-      long long cur = c[i] + carry;
-      res.a.push_back((int)(cur % 1000000));
-      carry = (int)(cur / 1000000);
-    }
-    res.a = convert_base(res.a, 6, base_digits);
     res.trim();
     return res;
   }
 
+  // info: this * this through the squaring paths, about 1.5x cheaper than a general product
+  BigInt square() const {
+    BigInt res;
+    mulInto(res, *this, *this);
+    return res;
+  }
+
   BigInt operator*(int v) const {
     BigInt res = *this;
     res *= v;
@@ -138,16 +142,14 @@ struct BigInt {
   void operator/=(int v) {
     if (v < 0)
       sign = -sign, v = -v;
-    for (int i = (int)a.size() - 1, rem = 0; i >= 0; --i) {
-      long long cur = a[i] + rem * (long long)base;
-      a[i] = (int)(cur / v);
-      rem = (int)(cur % v);
-    }
+    divAbsSmall(a, (limb_t)v);
     trim();
   }
 
   BigInt operator/(const BigInt& v) const {
-    return divmod(*this, v).first;
+    BigInt res;
+    divInto(res, *this, v);
+    return res;
   }
 
   BigInt operator/(int v) const {
@@ -157,29 +159,96 @@ struct BigInt {
   }
 
   BigInt operator%(const BigInt& v) const {
-    return divmod(*this, v).second;
+    BigInt res;
+    modInto(res, *this, v);
+    return res;
   }
 
   int operator%(int v) const {
     if (v < 0)
       v = -v;
-    int m = 0;
-    for (int i = a.size() - 1; i >= 0; --i)
-      m = (a[i] + m * (long long)base) % v;
-    return m * sign;
+    limb_t m = 0;
+    for (int i = (int)a.size() - 1; i >= 0; --i)
+      m = (limb_t)((((dlimb_t)m << limb_bits) | a[i]) % (limb_t)v);
+    return (int)m * sign;
   }
 
+  // compound operators work on this object's limbs, which only grow when the result needs more room
   void operator+=(const BigInt& v) {
-    *this = *this + v;
+    addSigned(v, v.sign);
   }
   void operator-=(const BigInt& v) {
-    *this = *this - v;
+    addSigned(v, -v.sign);
   }
   void operator*=(const BigInt& v) {
-    *this = *this * v;
+    mulInto(*this, *this, v);
   }
   void operator/=(const BigInt& v) {
-    *this = *this / v;
+    divInto(*this, *this, v);
+  }
+  void operator%=(const BigInt& v) {
+    modInto(*this, *this, v);
+  }
+
+  // info: res = x * y, written into res's limb storage. res may be x or y; the product is then built
+  //       in a per-thread scratch vector that trades storage with res, so no call allocates once the
+  //       buffers have grown to size.
+  static void mulInto(BigInt& res, const BigInt& x, const BigInt& y) {
+    int res_sign = x.sign * y.sign;
+    if (x.a.empty() || y.a.empty()) {
+      res.a.clear();
+      res.sign = 1;
+      return;
+    }
+    if (&res == &x || &res == &y) {
+      static thread_local limbs scratch(std::pmr::new_delete_resource());   // outlives any LimbArena
+      mulAbsInto(scratch, x.a, y.a);
+      res.a.assign(scratch.begin(), scratch.end());   // res keeps its own memory resource
+    }
+    else
+      mulAbsInto(res.a, x.a, y.a);
+    res.sign = res_sign;
+    res.trim();
+  }
+
+  // info: res = x % m (sign of x, as operator%), written into res's limb storage. res may be x or m.
+  static void modInto(BigInt& res, const BigInt& x, const BigInt& m) {
+    if (m.isZero())
+      throw std::domain_error("Division by zero");
+    static thread_local limbs quotient(std::pmr::new_delete_resource());
+    int res_sign = x.sign;
+    divmodAbs(quotient, res.a, x.a, m.a);
+    res.sign = res_sign;
+    res.trim();
+  }
+
+  // info: res = x / m (truncated, as operator/), written into res's limb storage. res may be x or m.
+  static void divInto(BigInt& res, const BigInt& x, const BigInt& m) {
+    if (m.isZero())
+      throw std::domain_error("Division by zero");
+    static thread_local limbs remainder(std::pmr::new_delete_resource());
+    int res_sign = x.sign * m.sign;
+    divmodAbs(res.a, remainder, x.a, m.a);
+    res.sign = res_sign;
+    res.trim();
+  }
+  // ----------
+
+  // ----- Bit shifts (magnitude only, sign is kept) -----
+  BigInt operator<<(int bits) const {
+    BigInt res;
+    shlAbs(res.a, a, bits);
+    res.sign = sign;
+    res.trim();
+    return res;
+  }
+
+  BigInt operator>>(int bits) const {
+    BigInt res;
+    shrAbs(res.a, a, bits);
+    res.sign = sign;
+    res.trim();
+    return res;
   }
   // ----------
 
@@ -187,12 +256,8 @@ struct BigInt {
   bool operator<(const BigInt& v) const {
     if (sign != v.sign)
       return sign < v.sign;
-    if (a.size() != v.a.size())
-      return a.size() * sign < v.a.size() * v.sign;
-    for (int i = a.size() - 1; i >= 0; i--)
-      if (a[i] != v.a[i])
-        return a[i] * sign < v.a[i] * sign;
-    return false;
+    int c = cmpAbs(a, v.a);
+    return sign > 0 ? c < 0 : c > 0;
   }
 
   bool operator>(const BigInt& v) const {
@@ -205,10 +270,10 @@ struct BigInt {
     return !(*this < v);
   }
   bool operator==(const BigInt& v) const {
-    return !(*this < v) && !(v < *this);
+    return sign == v.sign && a == v.a;
   }
   bool operator!=(const BigInt& v) const {
-    return *this < v || v < *this;
+    return !(*this == v);
   }
   // ----------
 
@@ -220,13 +285,11 @@ struct BigInt {
     return stream;
   }
 
+  // decimal output, or hex when the stream is set to std::hex
   friend std::ostream& operator<<(std::ostream& stream, const BigInt& v) {
-    if (v.sign == -1)
-      stream << '-';
-    stream << (v.a.empty() ? 0 : v.a.back());
-    for (int i = (int)v.a.size() - 2; i >= 0; --i)
-      stream << std::setw(base_digits) << std::setfill('0') << v.a[i];
-    return stream;
+    if ((stream.flags() & std::ios::basefield) == std::ios::hex)
+      return stream << v.toHex();
+    return stream << v.toDecimal();
   }
   // ----------
 
@@ -236,29 +299,22 @@ struct BigInt {
   // ******************** Utility methods ********************
 
   friend std::pair<BigInt, BigInt> divmod(const BigInt& a1, const BigInt& b1) {
-    int norm = base / (b1.a.back() + 1);
-    BigInt a = a1.abs() * norm;
-    BigInt b = b1.abs() * norm;
     BigInt q, r;
-    q.a.resize(a.a.size());
-
-    for (int i = a.a.size() - 1; i >= 0; i--) {
-      r *= base;
-      r += a.a[i];
-      int s1 = r.a.size() <= b.a.size() ? 0 : r.a[b.a.size()];
-      int s2 = r.a.size() <= b.a.size() - 1 ? 0 : r.a[b.a.size() - 1];
-      int d = ((long long)base * s1 + s2) / b.a.back();
-      r -= b * d;
-      while (r < 0)
-        r += b, --d;
-      q.a[i] = d;
-    }
-
-    q.sign = a1.sign * b1.sign;
-    r.sign = a1.sign;
+    divmod(a1, b1, q, r);
+    return std::make_pair(std::move(q), std::move(r));
+  }
+
+  // info: quotient and remainder from a single division, for callers that need both.
+  //       q and r reuse their limb storage and may each be a1 or b1 (but not each other).
+  friend void divmod(const BigInt& a1, const BigInt& b1, BigInt& q, BigInt& r) {
+    if (b1.isZero())
+      throw std::domain_error("Division by zero");
+    int q_sign = a1.sign * b1.sign, r_sign = a1.sign;
+    divmodAbs(q.a, r.a, a1.a, b1.a);
+    q.sign = q_sign;
+    r.sign = r_sign;
     q.trim();
     r.trim();
-    return std::make_pair(q, r / norm);
   }
 
   void trim() {
@@ -272,6 +328,31 @@ struct BigInt {
     return a.empty() || (a.size() == 1 && !a[0]);
   }
 
+  // info: *this += v_sign * |v| in place
+  void addSigned(const BigInt& v, int v_sign) {
+    if (this == &v) {   // x + x or x - x
+      if (v_sign == sign)
+        shlAbs(a, a, 1);
+      else
+        a.clear();
+      trim();
+      return;
+    }
+    if (v.a.empty())
+      return;
+    if (a.empty())
+      sign = v_sign;
+    if (sign == v_sign)
+      addAbsInPlace(a, v.a);
+    else if (cmpAbs(a, v.a) >= 0)
+      subAbsInPlace(a, v.a);
+    else {
+      rsubAbsInPlace(a, v.a);
+      sign = v_sign;
+    }
+    trim();
+  }
+
   BigInt abs() const {
     BigInt res = *this;
     res.sign *= res.sign;
@@ -279,113 +360,1203 @@ struct BigInt {
   }
 
   long long longValue() const {
-    long long res = 0;
-    for (int i = a.size() - 1; i >= 0; i--)
-      res = res * base + a[i];
+    long long res = a.empty() ? 0 : (long long)a[0];
     return res * sign;
   }
 
+  // info: number of significant bits in the magnitude (0 for zero)
+  int bitLength() const {
+    if (a.empty())
+      return 0;
+    return (int)(a.size() - 1) * limb_bits + (limb_bits - __builtin_clzll(a.back()));
+  }
+
+  // info: number of bytes toBytes needs for the magnitude (0 for zero)
+  size_t byteLength() const {
+    return (bitLength() + 7) / 8;
+  }
+
+  // info: number of decimal digits in the magnitude (1 for zero). a value of b bits has the digit
+  //       count of 2^(b-1) or one more, so at most one comparison with a power of ten settles it.
+  int digitCount() const {
+    if (a.empty())
+      return 1;
+    const double log10_2 = 0.30102999566398120;
+    int bits = bitLength();
+    int low = (int)((bits - 1) * log10_2) + 1;   // digits of 2^(bits - 1)
+    if ((int)(bits * log10_2) + 1 == low)         // 2^bits - 1 has no more
+      return low;
+    return cmpAbs(a, powerOfTen(low)) >= 0 ? low + 1 : low;
+  }
+
+  // info: value of bit i of the magnitude
+  bool testBit(int i) const {
+    int limb = i / limb_bits;
+    return limb < (int)a.size() && ((a[limb] >> (i % limb_bits)) & 1);
+  }
+
+  // info: index of the lowest set bit, the magnitude must be non-zero
+  int lowestSetBit() const {
+    int limb = 0;
+    while (!a[limb])
+      limb++;
+    return limb * limb_bits + __builtin_ctzll(a[limb]);
+  }
+
+  // info: the 64 bits of the magnitude starting at bit shift
+  limb_t bitsFrom(int shift) const {
+    int limb = shift / limb_bits, bit = shift % limb_bits;
+    limb_t res = limb < (int)a.size() ? a[limb] >> bit : 0;
+    if (bit && limb + 1 < (int)a.size())
+      res |= a[limb + 1] << (limb_bits - bit);
+    return res;
+  }
+
+  // info: greatest common divisor of |a| and |b|. binary gcd: only shifts and subtractions,
+  //       finished in machine words once both values fit in one limb.
   friend BigInt gcd(const BigInt& a, const BigInt& b) {
-    return b.isZero() ? a : gcd(b, a % b);
+    BigInt u, v;
+    u.a = a.a;
+    v.a = b.a;
+    if (u.isZero())
+      return v;
+    if (v.isZero())
+      return u;
+
+    int shift = std::min(u.lowestSetBit(), v.lowestSetBit());
+    shrAbs(u.a, u.a, u.lowestSetBit());
+    shrAbs(v.a, v.a, v.lowestSetBit());
+    u.trim();
+    v.trim();
+    while (!v.isZero()) {   // u and v are odd here
+      if (u.a.size() == 1 && v.a.size() == 1) {
+        limb_t x = u.a[0], y = v.a[0];
+        while (y) {
+          if (x > y)
+            std::swap(x, y);
+          y -= x;
+          if (y)
+            y >>= __builtin_ctzll(y);
+        }
+        u.a[0] = x;
+        break;
+      }
+      if (cmpAbs(u.a, v.a) > 0)
+        u.a.swap(v.a);
+      subAbsInPlace(v.a, u.a);
+      v.trim();
+      if (!v.isZero()) {
+        shrAbs(v.a, v.a, v.lowestSetBit());
+        v.trim();
+      }
+    }
+    shlAbs(u.a, u.a, shift);
+    u.trim();
+    return u;
+  }
+
+  // info: inverse of a modulo m (m > 1), the x in [0, m) with a * x = 1 (mod m). lehmer's extended
+  //       euclid: runs of quotient steps are found on the leading 63 bits in machine words and applied
+  //       to the full values as a single 2x2 cofactor matrix, so most steps need no long division.
+  friend BigInt modInverse(const BigInt& a, const BigInt& m) {
+    BigInt x = m, y = a % m;   // invariant: x = A * a and y = C * a (mod m)
+    if (y.sign < 0)
+      y += m;
+    BigInt A(0), C(1);
+    while (!y.isZero()) {
+      int shift = std::max(x.bitLength() - 63, 0);
+      long long xh = (long long)x.bitsFrom(shift), yh = (long long)y.bitsFrom(shift);
+
+      // knuth's algorithm L: a quotient is taken only if both bounds of the leading-bit ratio agree on it
+      long long ca = 1, cb = 0, cc = 0, cd = 1;
+      while (1) {
+        __int128 num1 = (__int128)xh + ca, den1 = (__int128)yh + cc;
+        __int128 num2 = (__int128)xh + cb, den2 = (__int128)yh + cd;
+        if (den1 <= 0 || den2 <= 0 || num1 < 0 || num2 < 0)
+          break;
+        __int128 q = num1 / den1;
+        if (q != num2 / den2)
+          break;
+        long long t = (long long)(ca - q * cc);
+        ca = cc;
+        cc = t;
+        t = (long long)(cb - q * cd);
+        cb = cd;
+        cd = t;
+        t = (long long)(xh - q * yh);
+        xh = yh;
+        yh = t;
+      }
+
+      if (cb == 0) {
+        // no step could be taken on the leading bits: one full-precision quotient step
+        BigInt q, r;
+        divmod(x, y, q, r);
+        x = y;
+        y = r;
+        BigInt t = A - q * C;
+        A = C;
+        C = t;
+      }
+      else {
+        BigInt nx = x * BigInt(ca) + y * BigInt(cb);
+        BigInt ny = x * BigInt(cc) + y * BigInt(cd);
+        BigInt nA = A * BigInt(ca) + C * BigInt(cb);
+        BigInt nC = A * BigInt(cc) + C * BigInt(cd);
+        x = nx;
+        y = ny;
+        A = nA;
+        C = nC;
+      }
+    }
+    if (x != BigInt(1))
+      throw std::invalid_argument("BigInt has no inverse for this modulus.");
+    A = A % m;
+    if (A.sign < 0)
+      A += m;
+    return A;
   }
   friend BigInt lcm(const BigInt& a, const BigInt& b) {
     return a / gcd(a, b) * b;
   }
 
+  // decimal input: an optional sign, then digits. long strings are split at a power of 10^19 and
+  // converted half by half (see decimalToAbs).
   void read(const std::string& s) {
+    size_t pos = readSign(s);
+    a = decimalToAbs(s.data() + pos, s.size() - pos);
+    trim();
+  }
+
+  // info: decimal digits of the value, with a leading '-' when negative. large values are split
+  //       by repeated division by 10^(19 * 2^k), which keeps the conversion subquadratic.
+  std::string toDecimal() const {
+    std::string res = sign < 0 ? "-" : "";
+    absToDecimal(res, a, 0);
+    if (a.empty())
+      res += '0';
+    return res;
+  }
+
+  // info: builds a BigInt from hex digits with an optional sign and 0x prefix, 16 digits per limb
+  static BigInt fromHex(const std::string& s) {
+    BigInt res;
+    size_t pos = res.readSign(s);
+    if (s.compare(pos, 2, "0x") == 0 || s.compare(pos, 2, "0X") == 0)
+      pos += 2;
+    size_t digits = s.size() - pos;
+    res.a.assign((digits + 15) / 16, 0);
+    for (size_t i = 0; i < digits; i++) {   // i counts from the least significant digit
+      char c = s[s.size() - 1 - i];
+      limb_t v;
+      if (c >= '0' && c <= '9')
+        v = c - '0';
+      else if (c >= 'a' && c <= 'f')
+        v = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        v = c - 'A' + 10;
+      else
+        throw std::invalid_argument("Invalid hex digit in BigInt string.");
+      res.a[i / 16] |= v << (4 * (i % 16));
+    }
+    res.trim();
+    return res;
+  }
+
+  // info: lowercase hex digits of the value without a prefix, with a leading '-' when negative
+  std::string toHex() const {
+    static const char digits[] = "0123456789abcdef";
+    if (a.empty())
+      return "0";
+    std::string res = sign < 0 ? "-" : "";
+    int top = (limb_bits - __builtin_clzll(a.back()) + 3) / 4;   // digits of the top limb
+    for (int i = (int)a.size() - 1; i >= 0; i--)
+      for (int d = (i == (int)a.size() - 1 ? top : 16) - 1; d >= 0; d--)
+        res += digits[(a[i] >> (4 * d)) & 15];
+    return res;
+  }
+
+  // info: builds a non-negative BigInt from big-endian (or little-endian) bytes
+  static BigInt fromBytes(const std::string& bytes, bool little_endian = false) {
+    return fromBytes(bytes.data(), bytes.size(), little_endian);
+  }
+
+  // info: builds a non-negative BigInt from length bytes, most significant first unless little_endian.
+  //       whole limbs are loaded 8 bytes at a time, only a partial top limb is assembled byte by byte.
+  static BigInt fromBytes(const char* bytes, size_t length, bool little_endian = false) {
+    BigInt res;
+    res.a.assign((length + 7) / 8, 0);
+    size_t whole = length / 8;
+    for (size_t l = 0; l < whole; l++)
+      res.a[l] = little_endian ? loadLittleEndian(bytes + 8 * l) : loadBigEndian(bytes + length - 8 * l - 8);
+    for (size_t i = 8 * whole; i < length; i++)
+      res.a[whole] |= (limb_t)(unsigned char)bytes[little_endian ? i : length - 1 - i] << (8 * (i % 8));
+    res.trim();
+    return res;
+  }
+
+  // info: bytes of the magnitude, most significant first unless little_endian, padded with zero
+  //       bytes on the significant side to length
+  // params: output length in bytes, must be at least byteLength()
+  std::string toBytes(size_t length, bool little_endian = false) const {
+    if (byteLength() > length)
+      throw std::range_error("BigInt does not fit in the requested number of bytes.");
+    std::string res(length, '\0');
+    size_t whole = std::min(a.size(), length / 8);
+    for (size_t l = 0; l < whole; l++) {
+      if (little_endian)
+        storeLittleEndian(&res[8 * l], a[l]);
+      else
+        storeBigEndian(&res[length - 8 * l - 8], a[l]);
+    }
+    for (size_t i = 8 * whole; i < length && i / 8 < a.size(); i++)   // a partial top limb
+      res[little_endian ? i : length - 1 - i] = (char)(a[i / 8] >> (8 * (i % 8)));
+    return res;
+  }
+
+  // info: the magnitude in byteLength() bytes
+  std::string toBytes() const {
+    return toBytes(byteLength());
+  }
+
+  bool isEven() const {
+    if (a.empty())
+      return false;
+    return (a[0] & 1) == 0;
+  }
+
+  const bool isOdd() const {
+    if (a.empty())
+      return false;
+    return (a[0] & 1) == 1;
+  }
+
+  // ****************************************
+
+
+  // ******************** Magnitude (limb vector) helpers ********************
+
+
+  // info: reads / writes one limb as 8 big-endian bytes
+  static limb_t loadBigEndian(const char* p) {
+    limb_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+  }
+
+  static void storeBigEndian(char* p, limb_t v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+  }
+
+  // info: reads / writes one limb as 8 little-endian bytes, a plain copy on little-endian hosts
+  static limb_t loadLittleEndian(const char* p) {
+    limb_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+  }
+
+  static void storeLittleEndian(char* p, limb_t v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+  }
+
+  // info: skips leading '+' and '-' signs of s into this->sign, returns the index of the first digit
+  size_t readSign(const std::string& s) {
     sign = 1;
-    a.clear();
-    int pos = 0;
-    while (pos < (int)s.size() && (s[pos] == '-' || s[pos] == '+')) {
+    size_t pos = 0;
+    for (; pos < s.size() && (s[pos] == '-' || s[pos] == '+'); pos++)
       if (s[pos] == '-')
         sign = -sign;
-      ++pos;
-    }
-    for (int i = s.size() - 1; i >= pos; i -= base_digits) {
-      int x = 0;
-      for (int j = std::max(pos, i - base_digits + 1); j <= i; j++)
-        x = x * 10 + s[j] - '0';
-      a.push_back(x);
+    return pos;
+  }
+
+  static const int DECIMAL_SPLIT_LIMBS = 32;   // magnitudes from this size convert to and from decimal by halves
+
+  // info: 10^(19 * 2^k), computed by repeated squaring once per thread and kept for later conversions
+  static const limbs& decimalPower(int k) {
+    static thread_local std::deque<limbs> powers;   // a deque keeps earlier references valid as it grows
+    while ((int)powers.size() <= k) {
+      powers.emplace_back(std::pmr::new_delete_resource());   // outlives any LimbArena
+      if (powers.size() == 1)
+        powers.back().assign(1, decimal_chunk);
+      else {
+        const limbs& prev = powers[powers.size() - 2];
+        limbs sq = multiplyAbs(prev, prev);
+        while (!sq.empty() && !sq.back())
+          sq.pop_back();
+        powers.back().assign(sq.begin(), sq.end());
+      }
     }
-    trim();
+    return powers[k];
   }
 
-  static std::vector<int> convert_base(const std::vector<int>& a, int old_digits, int new_digits) {
-    std::vector<long long> p(std::max(old_digits, new_digits) + 1);
-    p[0] = 1;
-    for (int i = 1; i < (int)p.size(); i++)
-      p[i] = p[i - 1] * 10;
-    std::vector<int> res;
-    long long cur = 0;
-    int cur_digits = 0;
-    for (int i = 0; i < (int)a.size(); i++) {
-      cur += a[i] * p[cur_digits];
-      cur_digits += old_digits;
-      while (cur_digits >= new_digits) {
-        res.push_back(int(cur % p[new_digits]));
-        cur /= p[new_digits];
-        cur_digits -= new_digits;
+  // info: 10^k as a magnitude, a product of the cached decimalPower values. the last result is kept,
+  //       since digit counts tend to be asked for the same size again.
+  static const limbs& powerOfTen(int k) {
+    static thread_local int cached_k = -1;
+    static thread_local limbs cached(std::pmr::new_delete_resource());
+    if (k == cached_k)
+      return cached;
+    limbs res(1, 1);
+    for (int i = 0; i < k % decimal_chunk_digits; i++)
+      mulAddAbsSmall(res, 10, 0);
+    for (int bit = 0; (k / decimal_chunk_digits) >> bit; bit++)
+      if (((k / decimal_chunk_digits) >> bit) & 1)
+        res = multiplyAbs(res, decimalPower(bit));
+    while (!res.empty() && !res.back())
+      res.pop_back();
+    cached.assign(res.begin(), res.end());
+    cached_k = k;
+    return cached;
+  }
+
+  // info: magnitude of the n decimal digits at s. short strings fold 19-digit chunks into the limbs
+  //       with one multiply-add each; longer ones are split so the low part is 19 * 2^k digits and
+  //       joined as high * 10^(19 * 2^k) + low.
+  static limbs decimalToAbs(const char* s, size_t n) {
+    limbs res;
+    if (n <= (size_t)DECIMAL_SPLIT_LIMBS * decimal_chunk_digits) {
+      size_t first = n % decimal_chunk_digits;
+      if (first == 0)
+        first = decimal_chunk_digits;
+      for (size_t i = 0; i < n; ) {
+        size_t len = (i == 0) ? first : decimal_chunk_digits;
+        limb_t x = 0, scale = 1;
+        for (size_t j = i; j < i + len && j < n; j++)
+          x = x * 10 + (s[j] - '0'), scale *= 10;
+        mulAddAbsSmall(res, scale, x);
+        i += len;
       }
+      return res;
     }
-    res.push_back((int)cur);
+    int k = 0;
+    while ((size_t)decimal_chunk_digits << (k + 1) < n)
+      k++;
+    size_t low_digits = (size_t)decimal_chunk_digits << k;
+    limbs high = decimalToAbs(s, n - low_digits);
+    limbs low = decimalToAbs(s + n - low_digits, low_digits);
+    if (!high.empty())
+      mulAbs(res, high, decimalPower(k));
+    addAbsInPlace(res, low);
     while (!res.empty() && !res.back())
       res.pop_back();
     return res;
   }
 
-  typedef std::vector<long long> vll;
+  // info: appends the decimal digits of magnitude x to out, zero-padded on the left to pad digits
+  //       (nothing for zero without padding). large x is divided by the 10^(19 * 2^k) just above
+  //       its square root, and quotient and remainder are converted in turn.
+  static void absToDecimal(std::string& out, const limbs& x, size_t pad) {
+    if (x.size() < (size_t)DECIMAL_SPLIT_LIMBS) {
+      limbs mag = x;
+      std::vector<limb_t> chunks;
+      while (!mag.empty())
+        chunks.push_back(divAbsSmall(mag, decimal_chunk));
+      std::string digits;
+      for (int i = (int)chunks.size() - 1; i >= 0; i--) {
+        std::string chunk = std::to_string(chunks[i]);
+        if (i != (int)chunks.size() - 1)
+          digits.append(decimal_chunk_digits - chunk.size(), '0');
+        digits += chunk;
+      }
+      if (digits.size() < pad)
+        out.append(pad - digits.size(), '0');
+      out += digits;
+      return;
+    }
+    int k = 0;
+    while (cmpAbs(decimalPower(k + 1), x) <= 0)
+      k++;
+    size_t low_digits = (size_t)decimal_chunk_digits << k;
+    limbs q, r;
+    divmodAbs(q, r, x, decimalPower(k));
+    while (!q.empty() && !q.back())
+      q.pop_back();
+    while (!r.empty() && !r.back())
+      r.pop_back();
+    absToDecimal(out, q, pad > low_digits ? pad - low_digits : 0);
+    absToDecimal(out, r, low_digits);
+  }
+
+  static const int BURNIKEL_ZIEGLER_THRESHOLD = 80;   // divisor limb count from which division recurses
+
+  // info: multiplication crossovers, in limbs of the shorter operand, and the basecase kernel. the
+  //       defaults were picked by tuneMultiplication() on an x86-64 build machine; call it to fit another
+  //       machine. the karatsuba thresholds must be at least 4, below that the half-size sums do not shrink.
+  struct MulThresholds {
+    int karatsuba;                   // schoolbook below, karatsuba from here
+    int karatsuba_square;            // the same for squares, whose schoolbook form is cheaper
+    int toom3;                       // toom-3 from here (balanced operands)
+    int ntt;                         // three-prime NTT from here
+    int simd_basecase;               // schoolbook products run on kernel from here, on the scalar one below
+    const BasecaseKernel* kernel;
+  };
+
+  // info: the installed thresholds. every product reads them once and passes that snapshot down its
+  //       recursion, so a concurrent setMulThresholds() never mixes two configurations in one product.
+  static const MulThresholds& mulThresholds() {
+    return *installedThresholds().load(std::memory_order_acquire);
+  }
+
+  // info: installs a complete set of thresholds for all later products, on every thread
+  static void setMulThresholds(const MulThresholds& thresholds) {
+    if (thresholds.karatsuba < 4 || thresholds.karatsuba_square < 4 || !thresholds.kernel)
+      throw std::invalid_argument("Karatsuba thresholds must be at least 4 and a basecase kernel must be set.");
+    static std::mutex lock;
+    static std::deque<MulThresholds> installed;   // never freed: a running product may still read an old one
+    std::lock_guard<std::mutex> guard(lock);
+    installed.push_back(thresholds);
+    installedThresholds().store(&installed.back(), std::memory_order_release);
+  }
+
+  static std::atomic<const MulThresholds*>& installedThresholds() {
+    static const MulThresholds defaults = { 40, 64, 320, 12000, 16, basecaseKernel() };
+    static std::atomic<const MulThresholds*> current(&defaults);
+    return current;
+  }
+
+  // info: compares two magnitudes, returns -1, 0 or 1
+  static int cmpAbs(const limbs& x, const limbs& y) {
+    if (x.size() != y.size())
+      return x.size() < y.size() ? -1 : 1;
+    for (int i = (int)x.size() - 1; i >= 0; i--)
+      if (x[i] != y[i])
+        return x[i] < y[i] ? -1 : 1;
+    return 0;
+  }
+
+  // info: res = x + y
+  static void addAbs(limbs& res, const limbs& x, const limbs& y) {
+    const limbs& big = x.size() >= y.size() ? x : y;
+    const limbs& small = x.size() >= y.size() ? y : x;
+    limbs out(big.size() + 1);
+    limb_t carry = 0;
+    for (size_t i = 0; i < big.size(); i++) {
+      dlimb_t cur = (dlimb_t)big[i] + (i < small.size() ? small[i] : 0) + carry;
+      out[i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
+    }
+    out[big.size()] = carry;
+    res.swap(out);
+  }
+
+  // info: res = x - y, requires |x| >= |y|
+  static void subAbs(limbs& res, const limbs& x, const limbs& y) {
+    limbs out(x.size());
+    limb_t borrow = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+      limb_t yi = i < y.size() ? y[i] : 0;
+      limb_t d = x[i] - yi - borrow;
+      borrow = (x[i] < yi) || (x[i] - yi < borrow);
+      out[i] = d;
+    }
+    res.swap(out);
+  }
+
+  // info: x = x * m + add, for single-limb m and add
+  static void mulAddAbsSmall(limbs& x, limb_t m, limb_t add) {
+    limb_t carry = add;
+    for (size_t i = 0; i < x.size(); i++) {
+      dlimb_t cur = (dlimb_t)x[i] * m + carry;
+      x[i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
+    }
+    if (carry)
+      x.push_back(carry);
+  }
+
+  // info: x = x / d for a single-limb d, trims x and returns the remainder
+  static limb_t divAbsSmall(limbs& x, limb_t d) {
+    dlimb_t rem = 0;
+    for (int i = (int)x.size() - 1; i >= 0; --i) {
+      dlimb_t cur = (rem << limb_bits) | x[i];
+      x[i] = (limb_t)(cur / d);
+      rem = cur % d;
+    }
+    while (!x.empty() && !x.back())
+      x.pop_back();
+    return (limb_t)rem;
+  }
+
+  // info: res = x << bits. res may be x; limbs are written from the top down so none is read after it is overwritten
+  static void shlAbs(limbs& res, const limbs& x, int bits) {
+    int limb_shift = bits / limb_bits, bit_shift = bits % limb_bits;
+    int xn = (int)x.size();
+    res.resize(xn + limb_shift + 1);
+    for (int i = xn + limb_shift; i >= 0; i--) {
+      int j = i - limb_shift;   // source limb of the low part
+      limb_t cur = (j >= 0 && j < xn) ? x[j] << bit_shift : 0;
+      if (bit_shift && j - 1 >= 0 && j - 1 < xn)
+        cur |= x[j - 1] >> (limb_bits - bit_shift);
+      res[i] = cur;
+    }
+  }
+
+  // info: res = x >> bits. res may be x; limbs are written from the bottom up so none is read after it is overwritten
+  static void shrAbs(limbs& res, const limbs& x, int bits) {
+    int limb_shift = bits / limb_bits, bit_shift = bits % limb_bits;
+    size_t xn = x.size();
+    if (limb_shift >= (int)xn) {
+      res.clear();
+      return;
+    }
+    size_t n = xn - limb_shift;
+    if (&res != &x)
+      res.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      limb_t cur = x[i + limb_shift] >> bit_shift;
+      if (bit_shift && i + limb_shift + 1 < xn)
+        cur |= x[i + limb_shift + 1] << (limb_bits - bit_shift);
+      res[i] = cur;
+    }
+    res.resize(n);
+  }
+
+  // info: res = x * y
+  static void mulAbs(limbs& res, const limbs& x, const limbs& y, const MulThresholds& thresholds = mulThresholds()) {
+    limbs out = multiplyAbs(x, y, thresholds);
+    res.swap(out);
+  }
+
+  // info: res = x * y for a res distinct from x and y. schoolbook products are written straight into
+  //       res's storage, so they allocate nothing once res has the capacity. x and y may be the same
+  //       vector, which takes the squaring path.
+  static void mulAbsInto(limbs& res, const limbs& x, const limbs& y) {
+    const MulThresholds& thresholds = mulThresholds();
+    if (std::min(x.size(), y.size()) < (size_t)(&x == &y ? thresholds.karatsuba_square : thresholds.karatsuba)) {
+      res.resize(x.size() + y.size());
+      if (&x == &y)
+        basecaseSquare(res.data(), x.data(), x.size());
+      else
+        basecaseMultiply(res.data(), x.data(), x.size(), y.data(), y.size(), thresholds);
+    }
+    else
+      mulAbs(res, x, y, thresholds);
+  }
 
-  static vll karatsubaMultiply(const vll& a, const vll& b) {
-    int n = a.size();
-    vll res(n + n);
-    if (n <= 32) {
-      for (int i = 0; i < n; i++)
-        for (int j = 0; j < n; j++)
-          res[i + j] += a[i] * b[j];
+  // info: product of two magnitudes, with the algorithm picked by the size of the shorter operand:
+  //       schoolbook, karatsuba, toom-3, then NTT. x and y being the same vector selects the squaring
+  //       variant of each. unbalanced operands below the NTT size are cut into pieces the size of the
+  //       shorter one, so nothing is padded.
+  static limbs multiplyAbs(const limbs& x, const limbs& y, const MulThresholds& thresholds = mulThresholds()) {
+    if (x.size() < y.size())
+      return multiplyAbs(y, x, thresholds);
+    size_t n = x.size(), m = y.size();
+    if (m == 0)
+      return limbs();
+    if (&x == &y && m < (size_t)thresholds.karatsuba_square) {
+      limbs res(2 * n);
+      basecaseSquare(res.data(), x.data(), n);
       return res;
     }
+    if (&x != &y && m < (size_t)thresholds.karatsuba)
+      return basecaseMultiply(x, y, thresholds);
+    if (m >= (size_t)thresholds.ntt) {
+      limbs res(n + m);
+      nttMultiply(res.data(), x.data(), n, y.data(), m);
+      return res;
+    }
+    if (2 * m <= n) {   // unbalanced: multiply y by each m-limb slice of x
+      limbs res(n + m, 0);
+      for (size_t off = 0; off < n; off += m) {
+        limbs slice(x.begin() + off, x.begin() + std::min(n, off + m));
+        limbs part = multiplyAbs(slice, y, thresholds);
+        addAbsAt(res, part, off);
+      }
+      return res;
+    }
+    if (m >= (size_t)thresholds.toom3)
+      return toom3Multiply(x, y, thresholds);
+    return karatsubaMultiply(x, y, thresholds);
+  }
 
-    int k = n >> 1;
-    vll a1(a.begin(), a.begin() + k);
-    vll a2(a.begin() + k, a.end());
-    vll b1(b.begin(), b.begin() + k);
-    vll b2(b.begin() + k, b.end());
-
-    vll a1b1 = karatsubaMultiply(a1, b1);
-    vll a2b2 = karatsubaMultiply(a2, b2);
-
-    for (int i = 0; i < k; i++)
-      a2[i] += a1[i];
-    for (int i = 0; i < k; i++)
-      b2[i] += b1[i];
-
-    vll r = karatsubaMultiply(a2, b2);
-    for (int i = 0; i < (int)a1b1.size(); i++)
-      r[i] -= a1b1[i];
-    for (int i = 0; i < (int)a2b2.size(); i++)
-      r[i] -= a2b2[i];
-
-    for (int i = 0; i < (int)r.size(); i++)
-      res[i + k] += r[i];
-    for (int i = 0; i < (int)a1b1.size(); i++)
-      res[i] += a1b1[i];
-    for (int i = 0; i < (int)a2b2.size(); i++)
-      res[i + n] += a2b2[i];
+  // info: schoolbook product of two magnitudes
+  static limbs basecaseMultiply(const limbs& x, const limbs& y, const MulThresholds& thresholds) {
+    limbs res(x.size() + y.size());
+    basecaseMultiply(res.data(), x.data(), x.size(), y.data(), y.size(), thresholds);
     return res;
   }
 
-  bool isEven() const {
-    if ((*this) == BigInt(0))
-      return false;
-    return a[0] % 2 == 0;
+  // info: schoolbook product into res[0 .. xn + yn), which must not overlap x or y. from the
+  //       simd_basecase threshold on it runs on the thresholds' kernel (see BasecaseKernels.cpp).
+  static void basecaseMultiply(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn,
+                               const MulThresholds& thresholds) {
+    if (std::min(xn, yn) >= (size_t)thresholds.simd_basecase)
+      thresholds.kernel->mul(res, x, xn, y, yn);
+    else
+      scalarBasecaseMul(res, x, xn, y, yn);
   }
 
-  const bool isOdd() const {
-    if ((*this) == BigInt(0))
-      return false;
-    return a[0] % 2 == 1;
+  // info: schoolbook square into res[0 .. 2n), which must not overlap x. each cross product x[i] * x[j]
+  //       (i < j) is formed once and doubled, then the n squares x[i]^2 are added: about half the limb
+  //       products of a general multiply.
+  static void basecaseSquare(limb_t* res, const limb_t* x, size_t n) {
+    std::fill(res, res + 2 * n, 0);
+    for (size_t i = 0; i + 1 < n; i++) {
+      limb_t carry = 0;
+      for (size_t j = i + 1; j < n; j++) {
+        dlimb_t cur = (dlimb_t)x[i] * x[j] + res[i + j] + carry;
+        res[i + j] = (limb_t)cur;
+        carry = (limb_t)(cur >> limb_bits);
+      }
+      res[i + n] = carry;
+    }
+    limb_t top = 0;   // double the cross products
+    for (size_t i = 0; i < 2 * n; i++) {
+      limb_t next = res[i] >> (limb_bits - 1);
+      res[i] = (res[i] << 1) | top;
+      top = next;
+    }
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+      dlimb_t sq = (dlimb_t)x[i] * x[i];
+      dlimb_t lo = (dlimb_t)res[2 * i] + (limb_t)sq + carry;
+      res[2 * i] = (limb_t)lo;
+      dlimb_t hi = (dlimb_t)res[2 * i + 1] + (limb_t)(sq >> limb_bits) + (limb_t)(lo >> limb_bits);
+      res[2 * i + 1] = (limb_t)hi;
+      carry = (limb_t)(hi >> limb_bits);
+    }
+  }
+
+  // info: karatsuba product (or square, when x and y are the same vector) for n = |x| >= |y| > n / 2.
+  //       the recursion works on limb ranges and takes every temporary from one per-thread scratch buffer.
+  static limbs karatsubaMultiply(const limbs& x, const limbs& y, const MulThresholds& thresholds) {
+    static thread_local limbs scratch(std::pmr::new_delete_resource());
+    size_t n = x.size(), m = y.size();
+    scratch.resize(karatsubaScratch(n, thresholds));
+    limbs res(n + m);
+    if (&x == &y)
+      karatsubaSquare(res.data(), x.data(), n, scratch.data(), thresholds);
+    else
+      karatsubaMultiply(res.data(), x.data(), n, y.data(), m, scratch.data(), thresholds);
+    return res;
+  }
+
+  // info: scratch limbs needed by karatsubaMultiply and karatsubaSquare for operands of up to n limbs:
+  //       four half-size-plus-one blocks per level for the sums and the middle product
+  static size_t karatsubaScratch(size_t n, const MulThresholds& thresholds) {
+    if (n < (size_t)std::min(thresholds.karatsuba, thresholds.karatsuba_square))
+      return 0;
+    size_t h = n - n / 2 + 1;
+    return 4 * h + karatsubaScratch(h, thresholds);
+  }
+
+  // info: res[0 .. n + m) = x * y for any n, m > 0. res must not overlap x, y or scratch, which must
+  //       hold karatsubaScratch(max(n, m)) limbs for the same thresholds.
+  static void karatsubaMultiply(limb_t* res, const limb_t* x, size_t n, const limb_t* y, size_t m, limb_t* scratch,
+                                const MulThresholds& thresholds) {
+    if (n < m) {
+      std::swap(x, y);
+      std::swap(n, m);
+    }
+    if (m < (size_t)thresholds.karatsuba) {
+      basecaseMultiply(res, x, n, y, m, thresholds);
+      return;
+    }
+    if (2 * m <= n) {   // unbalanced: y times each m-limb slice of x, the slice products go through scratch
+      karatsubaMultiply(res, x, m, y, m, scratch, thresholds);
+      for (size_t off = m; off < n; off += m) {
+        size_t len = std::min(m, n - off);
+        karatsubaMultiply(scratch, x + off, len, y, m, scratch + 2 * m, thresholds);
+        limb_t carry = addSpans(res + off, res + off, m, scratch, m);
+        for (size_t i = m; i < len + m; i++) {
+          dlimb_t cur = (dlimb_t)scratch[i] + carry;
+          res[off + i] = (limb_t)cur;
+          carry = (limb_t)(cur >> limb_bits);
+        }
+      }
+      return;
+    }
+
+    size_t k = n / 2, xh = n - k, yh = m - k;   // low halves of k limbs, m > k
+    karatsubaMultiply(res, x, k, y, k, scratch, thresholds);
+    karatsubaMultiply(res + 2 * k, x + k, xh, y + k, yh, scratch, thresholds);
+
+    limb_t* xs = scratch;                 // x1 + x2, xh + 1 limbs
+    limb_t* ys = xs + xh + 1;             // y1 + y2, xh + 1 limbs (yh <= xh)
+    limb_t* mid = ys + xh + 1;            // (x1 + x2)(y1 + y2), 2 xh + 2 limbs
+    xs[xh] = addSpans(xs, x + k, xh, x, k);
+    size_t ysn = std::max(k, yh);
+    ys[ysn] = yh >= k ? addSpans(ys, y + k, yh, y, k) : addSpans(ys, y, k, y + k, yh);
+    karatsubaMultiply(mid, xs, xh + 1, ys, ysn + 1, mid + 2 * xh + 2, thresholds);
+
+    size_t midn = xh + ysn + 2;
+    subSpans(mid, midn, res, 2 * k);
+    subSpans(mid, midn, res + 2 * k, n + m - 2 * k);
+    addSpans(res + k, res + k, n + m - k, mid, std::min(midn, n + m - k));
+  }
+
+  // info: res[0 .. 2n) = x^2 with karatsuba's three half-size squares. res must not overlap x or scratch,
+  //       which must hold karatsubaScratch(n) limbs for the same thresholds.
+  static void karatsubaSquare(limb_t* res, const limb_t* x, size_t n, limb_t* scratch, const MulThresholds& thresholds) {
+    if (n < (size_t)thresholds.karatsuba_square) {
+      basecaseSquare(res, x, n);
+      return;
+    }
+    size_t k = n / 2, xh = n - k;
+    karatsubaSquare(res, x, k, scratch, thresholds);
+    karatsubaSquare(res + 2 * k, x + k, xh, scratch, thresholds);
+
+    limb_t* xs = scratch;                 // x1 + x2, xh + 1 limbs
+    limb_t* mid = xs + xh + 1;            // (x1 + x2)^2, 2 xh + 2 limbs
+    xs[xh] = addSpans(xs, x + k, xh, x, k);
+    karatsubaSquare(mid, xs, xh + 1, mid + 2 * xh + 2, thresholds);
+
+    size_t midn = 2 * xh + 2;
+    subSpans(mid, midn, res, 2 * k);
+    subSpans(mid, midn, res + 2 * k, 2 * n - 2 * k);
+    addSpans(res + k, res + k, 2 * n - k, mid, std::min(midn, 2 * n - k));
+  }
+
+  // info: res[0 .. xn) = x + y for xn >= yn, returns the carry out. res may be x.
+  static limb_t addSpans(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < xn; i++) {
+      dlimb_t cur = (dlimb_t)x[i] + (i < yn ? y[i] : 0) + carry;
+      res[i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
+    }
+    return carry;
+  }
+
+  // info: x[0 .. xn) -= y[0 .. yn) for x >= y and xn >= yn
+  static void subSpans(limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+    limb_t borrow = 0;
+    for (size_t i = 0; i < xn && (i < yn || borrow); i++) {
+      limb_t yi = i < yn ? y[i] : 0;
+      limb_t d = x[i] - yi - borrow;
+      borrow = (x[i] < yi) || (x[i] - yi < borrow);
+      x[i] = d;
+    }
+  }
+
+  // info: toom-3 product (or square, when x and y are the same vector) for n = |x| >= |y| > n / 2: both operands are cut into three parts of
+  //       k = ceil(n / 3) limbs and treated as polynomials in base^k, evaluated at 0, 1, -1, -2 and
+  //       infinity, multiplied pointwise (five third-size products instead of nine) and interpolated
+  //       with bodrato's sequence, whose divisions by 2 and 3 are exact.
+  static limbs toom3Multiply(const limbs& x, const limbs& y, const MulThresholds& thresholds) {
+    size_t n = x.size(), k = (n + 2) / 3;
+    BigInt x0, x1, x2, y0, y1, y2;
+    x0.a = sliceAbs(x, 0, k);
+    x1.a = sliceAbs(x, k, 2 * k);
+    x2.a = sliceAbs(x, 2 * k, n);
+    y0.a = sliceAbs(y, 0, k);
+    y1.a = sliceAbs(y, k, 2 * k);
+    y2.a = sliceAbs(y, 2 * k, y.size());
+
+    BigInt px = x0 + x2, py = y0 + y2;
+    BigInt p1x = px + x1, p1y = py + y1;
+    BigInt pm1x = px - x1, pm1y = py - y1;
+    BigInt pm2x = ((pm1x + x2) << 1) - x0, pm2y = ((pm1y + y2) << 1) - y0;
+
+    // the five pointwise products, on the same thresholds as the product they are part of
+    auto product = [&thresholds](const BigInt& u, const BigInt& v) {
+      BigInt res;
+      res.a = multiplyAbs(u.a, v.a, thresholds);
+      res.sign = u.sign * v.sign;
+      res.trim();
+      return res;
+    };
+    BigInt r0, r1, rm1, rm2, rinf;
+    if (&x == &y) {   // squaring: the y evaluations equal the x ones
+      r0 = product(x0, x0);
+      r1 = product(p1x, p1x);
+      rm1 = product(pm1x, pm1x);
+      rm2 = product(pm2x, pm2x);
+      rinf = product(x2, x2);
+    }
+    else {
+      r0 = product(x0, y0);
+      r1 = product(p1x, p1y);
+      rm1 = product(pm1x, pm1y);
+      rm2 = product(pm2x, pm2y);
+      rinf = product(x2, y2);
+    }
+
+    BigInt r3 = rm2 - r1;
+    r3 /= 3;
+    r1 = (r1 - rm1) >> 1;
+    BigInt r2 = rm1 - r0;
+    r3 = ((r2 - r3) >> 1) + (rinf << 1);
+    r2 += r1;
+    r2 -= rinf;
+    r1 -= r3;
+
+    limbs res(n + y.size(), 0);
+    addAbsAt(res, r0.a, 0);
+    addAbsAt(res, r1.a, k);
+    addAbsAt(res, r2.a, 2 * k);
+    addAbsAt(res, r3.a, 3 * k);
+    addAbsAt(res, rinf.a, 4 * k);
+    return res;
+  }
+
+  // info: measures the multiplication crossovers on this machine and installs them, after picking the
+  //       fastest basecase kernel. each level is timed against the one below it at growing sizes, with
+  //       the level under test applied only at the top, and the threshold is the first size it wins.
+  //       the candidate thresholds are private to the measurement; the result is installed in one step,
+  //       so threads multiplying meanwhile see either the old thresholds or the new ones. takes about a second.
+  // returns: the installed thresholds
+  static MulThresholds tuneMultiplication() {
+    MulThresholds thresholds = mulThresholds();
+    const int never = 1 << 30;
+    thresholds.toom3 = never;
+    thresholds.ntt = never;
+
+    std::mt19937_64 gen(1);
+    auto operand = [&gen](int size) {
+      limbs v(size);
+      for (int i = 0; i < size; i++)
+        v[i] = gen();
+      return v;
+    };
+    // best of a few runs, each repeated to at least a millisecond
+    auto timeOf = [](const std::function<void()>& body) {
+      double best = 1e30;
+      for (int run = 0; run < 3; run++) {
+        int reps = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed;
+        do {
+          body();
+          reps++;
+          elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < 1e-3);
+        best = std::min(best, elapsed / reps);
+      }
+      return best;
+    };
+    // first size of the ladder at which faster() beats slower() twice in a row, else the top of the ladder
+    auto crossover = [&](int from, int to, const std::function<void(int)>& prepare,
+                         const std::function<void(const limbs&, const limbs&)>& faster,
+                         const std::function<void(const limbs&, const limbs&)>& slower) {
+      int wins = 0, first = to;
+      for (int size = from; size <= to; size += std::max(1, size / 8)) {
+        prepare(size);
+        limbs x = operand(size), y = operand(size);
+        bool won = timeOf([&] { faster(x, y); }) < timeOf([&] { slower(x, y); });
+        if (won && wins++ == 0)
+          first = size;
+        if (!won)
+          wins = 0;
+        if (wins == 2)
+          return first;
+      }
+      return to;
+    };
+
+    // the basecase kernel fastest on 32-limb operands, and the size from which it beats the scalar one
+    double best_time = 1e30;
+    for (const BasecaseKernel& kernel : basecaseKernels()) {
+      limbs x = operand(32), y = operand(32), res(64);
+      double time = timeOf([&] { kernel.mul(res.data(), x.data(), 32, y.data(), 32); });
+      if (time < best_time) {
+        best_time = time;
+        thresholds.kernel = &kernel;
+      }
+    }
+    if (thresholds.kernel == &basecaseKernels().front())
+      thresholds.simd_basecase = never;
+    else
+      thresholds.simd_basecase = crossover(2, 64, [](int) {},
+        [&](const limbs& x, const limbs& y) { limbs res(2 * x.size()); thresholds.kernel->mul(res.data(), x.data(), x.size(), y.data(), y.size()); },
+        [](const limbs& x, const limbs& y) { limbs res(2 * x.size()); scalarBasecaseMul(res.data(), x.data(), x.size(), y.data(), y.size()); });
+
+    thresholds.karatsuba = crossover(8, 256, [&](int size) { thresholds.karatsuba = size; },
+      [&](const limbs& x, const limbs& y) { karatsubaMultiply(x, y, thresholds); },
+      [&](const limbs& x, const limbs& y) { basecaseMultiply(x, y, thresholds); });
+    thresholds.karatsuba_square = crossover(8, 256, [&](int size) { thresholds.karatsuba_square = size; },
+      [&](const limbs& x, const limbs&) { karatsubaMultiply(x, x, thresholds); },
+      [](const limbs& x, const limbs&) { limbs res(2 * x.size()); basecaseSquare(res.data(), x.data(), x.size()); });
+    thresholds.toom3 = crossover(thresholds.karatsuba * 2, 1024, [&](int size) { thresholds.toom3 = size; },
+      [&](const limbs& x, const limbs& y) { toom3Multiply(x, y, thresholds); },
+      [&](const limbs& x, const limbs& y) { karatsubaMultiply(x, y, thresholds); });
+    thresholds.ntt = crossover(thresholds.toom3, 1 << 14, [](int) {},
+      [](const limbs& x, const limbs& y) { limbs res(x.size() + y.size()); nttMultiply(res.data(), x.data(), x.size(), y.data(), y.size()); },
+      [&](const limbs& x, const limbs& y) { multiplyAbs(x, y, thresholds); });
+    setMulThresholds(thresholds);
+    return thresholds;
+  }
+
+  // info: x += y * base^offset; x must be long enough to hold the result
+  static void addAbsAt(limbs& x, const limbs& y, size_t offset) {
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i < y.size() && offset + i < x.size(); i++) {
+      dlimb_t cur = (dlimb_t)x[offset + i] + y[i] + carry;
+      x[offset + i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
+    }
+    for (i += offset; carry && i < x.size(); i++) {
+      x[i] += carry;
+      carry = x[i] == 0;
+    }
+  }
+
+  // info: x -= y, requires x >= y
+  static void subAbsInPlace(limbs& x, const limbs& y) {
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i < y.size(); i++) {
+      limb_t yi = y[i];
+      limb_t d = x[i] - yi - borrow;
+      borrow = (x[i] < yi) || (x[i] - yi < borrow);
+      x[i] = d;
+    }
+    for (; borrow && i < x.size(); i++) {
+      borrow = x[i] == 0;
+      x[i]--;
+    }
+  }
+
+  // info: x += y
+  static void addAbsInPlace(limbs& x, const limbs& y) {
+    if (x.size() < y.size())
+      x.resize(y.size(), 0);
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i < y.size(); i++) {
+      dlimb_t cur = (dlimb_t)x[i] + y[i] + carry;
+      x[i] = (limb_t)cur;
+      carry = (limb_t)(cur >> limb_bits);
+    }
+    for (; carry && i < x.size(); i++) {
+      x[i] += carry;
+      carry = x[i] == 0;
+    }
+    if (carry)
+      x.push_back(carry);
+  }
+
+  // info: x = y - x, requires y >= x
+  static void rsubAbsInPlace(limbs& x, const limbs& y) {
+    x.resize(y.size(), 0);
+    limb_t borrow = 0;
+    for (size_t i = 0; i < y.size(); i++) {
+      limb_t xi = x[i];
+      x[i] = y[i] - xi - borrow;
+      borrow = (y[i] < xi) || (y[i] - xi < borrow);
+    }
+  }
+
+  // info: q = x / y, r = x % y for magnitudes, y non-zero. q and r may each be x or y (but not each
+  //       other). large divisions go to burnikel-ziegler, the rest to knuth's algorithm D.
+  static void divmodAbs(limbs& q, limbs& r, const limbs& x, const limbs& y) {
+    size_t yn = y.size();
+    while (yn && !y[yn - 1])
+      yn--;
+    size_t xn = x.size();
+    while (xn && !x[xn - 1])
+      xn--;
+    bool smaller = xn < yn;
+    for (size_t i = xn; !smaller && xn == yn && i-- > 0; ) {
+      if (x[i] != y[i]) {
+        smaller = x[i] < y[i];
+        break;
+      }
+    }
+    if (smaller) {
+      if (&r != &x)
+        r = x;
+      q.clear();
+      return;
+    }
+    if (yn == 1) {
+      limb_t d = y[0];
+      q = x;
+      limb_t rem = divAbsSmall(q, d);
+      r.clear();
+      if (rem)
+        r.push_back(rem);
+      return;
+    }
+    if (yn >= (size_t)BURNIKEL_ZIEGLER_THRESHOLD && xn - yn >= (size_t)BURNIKEL_ZIEGLER_THRESHOLD / 2)
+      divmodRecursive(q, r, x, xn, y, yn);
+    else
+      divmodKnuth(q, r, x, y, yn);
+  }
+
+  // info: knuth's algorithm D for x >= y, where y has yn >= 2 significant limbs. q and r may be x or y;
+  //       the normalized operands live in per-thread scratch vectors, so repeated calls reuse them.
+  static void divmodKnuth(limbs& q, limbs& r, const limbs& x, const limbs& y, size_t yn) {
+    // normalize so the top limb of the divisor has its high bit set
+    static thread_local limbs v(std::pmr::new_delete_resource()), u(std::pmr::new_delete_resource());
+    int s = __builtin_clzll(y[yn - 1]);
+    shlAbs(v, y, s);
+    v.resize(yn);
+    shlAbs(u, x, s);
+    u.resize(x.size() + 1);
+
+    size_t n = v.size(), m = x.size() - n;
+    q.assign(m + 1, 0);
+    for (int j = (int)m; j >= 0; j--) {
+      dlimb_t num = ((dlimb_t)u[j + n] << limb_bits) | u[j + n - 1];
+      dlimb_t qhat = num / v[n - 1];
+      dlimb_t rhat = num % v[n - 1];
+      while (qhat >> limb_bits || qhat * v[n - 2] > ((rhat << limb_bits) | u[j + n - 2])) {
+        qhat--;
+        rhat += v[n - 1];
+        if (rhat >> limb_bits)
+          break;
+      }
+
+      // u[j .. j+n] -= qhat * v
+      limb_t mul_carry = 0, borrow = 0;
+      for (size_t i = 0; i < n; i++) {
+        dlimb_t p = qhat * v[i] + mul_carry;
+        mul_carry = (limb_t)(p >> limb_bits);
+        limb_t pl = (limb_t)p;
+        limb_t d = u[i + j] - pl - borrow;
+        borrow = (u[i + j] < pl) || (u[i + j] - pl < borrow);
+        u[i + j] = d;
+      }
+      limb_t top = u[j + n];
+      u[j + n] = top - mul_carry - borrow;
+      bool negative = (top < mul_carry) || (top - mul_carry < borrow);
+
+      if (negative) {   // qhat was one too large: add the divisor back
+        qhat--;
+        limb_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+          dlimb_t cur = (dlimb_t)u[i + j] + v[i] + carry;
+          u[i + j] = (limb_t)cur;
+          carry = (limb_t)(cur >> limb_bits);
+        }
+        u[j + n] += carry;
+      }
+      q[j] = (limb_t)qhat;
+    }
+
+    u.resize(n);
+    shrAbs(r, u, s);
+    trimAbs(q);
+    trimAbs(r);
+  }
+
+  // info: burnikel-ziegler recursive division for x with xn and y with yn significant limbs. the divisor
+  //       is shifted up to a block of n = j * 2^k limbs with its top bit set, the dividend is cut into
+  //       blocks of n limbs, and each two-block step halves down to knuth divisions of j limbs, so the
+  //       work is carried by (karatsuba) multiplications instead of limb-by-limb quotient digits.
+  static void divmodRecursive(limbs& q, limbs& r, const limbs& x, size_t xn, const limbs& y, size_t yn) {
+    size_t blocks = 1;
+    while (blocks * BURNIKEL_ZIEGLER_THRESHOLD <= yn)
+      blocks <<= 1;
+    size_t n = (yn + blocks - 1) / blocks * blocks;
+    int sigma = (int)(n * limb_bits) - ((int)(yn - 1) * limb_bits + (limb_bits - __builtin_clzll(y[yn - 1])));
+
+    limbs b, a;   // copies first, so q and r may be x or y
+    shlAbs(b, limbs(y.begin(), y.begin() + yn), sigma);
+    b.resize(n);
+    shlAbs(a, limbs(x.begin(), x.begin() + xn), sigma);
+    trimAbs(a);
+
+    // t blocks of n limbs with a free top bit, so the top block is below b
+    size_t a_bits = (a.size() - 1) * limb_bits + (limb_bits - __builtin_clzll(a.back()));
+    size_t t = std::max<size_t>(2, a_bits / (n * limb_bits) + 1);
+    a.resize(t * n, 0);
+
+    limbs z(a.begin() + (t - 2) * n, a.end()), qi, ri;
+    trimAbs(z);
+    limbs quotient((t - 1) * n, 0);
+    for (size_t i = t - 1; i-- > 0; ) {
+      divide2n1n(qi, ri, z, b, n);
+      std::copy(qi.begin(), qi.end(), quotient.begin() + i * n);
+      if (i > 0)
+        joinAbs(z, ri, limbs(a.begin() + (i - 1) * n, a.begin() + i * n), n);
+    }
+    trimAbs(quotient);
+    q.swap(quotient);
+    shrAbs(r, ri, sigma);
+    trimAbs(r);
+  }
+
+  // info: q = a / b, r = a % b for an n-limb normalized b and a < b * base^n
+  static void divide2n1n(limbs& q, limbs& r, const limbs& a, const limbs& b, size_t n) {
+    if (n % 2 || n <= (size_t)BURNIKEL_ZIEGLER_THRESHOLD) {
+      if (cmpAbs(a, b) < 0) {
+        q.clear();
+        r = a;
+      }
+      else
+        divmodKnuth(q, r, a, b, n);
+      return;
+    }
+    size_t h = n / 2;
+    limbs q1, q2, rest;
+    divide3n2n(q1, rest, sliceAbs(a, h, a.size()), b, h);
+    joinAbs(rest, rest, sliceAbs(a, 0, h), h);
+    divide3n2n(q2, r, rest, b, h);
+    joinAbs(q, q1, q2, h);
+  }
+
+  // info: q = a / b, r = a % b for a 2h-limb normalized b and a < b * base^h (three blocks of h limbs)
+  static void divide3n2n(limbs& q, limbs& r, const limbs& a, const limbs& b, size_t h) {
+    limbs b1 = sliceAbs(b, h, 2 * h), b2 = sliceAbs(b, 0, h);
+    limbs a12 = sliceAbs(a, h, a.size()), r1;
+    if (cmpAbs(sliceAbs(a, 2 * h, a.size()), b1) < 0)
+      divide2n1n(q, r1, a12, b1, h);
+    else {   // top blocks equal: the quotient is base^h - 1 and a12 - q * b1 = a12 - b1 * base^h + b1
+      q.assign(h, ~(limb_t)0);
+      limbs shifted;
+      joinAbs(shifted, b1, limbs(), h);
+      r1 = a12;
+      addAbsInPlace(r1, b1);
+      subAbsInPlace(r1, shifted);
+      trimAbs(r1);
+    }
+
+    limbs d;
+    mulAbsInto(d, q, b2);
+    trimAbs(d);
+    joinAbs(r, r1, sliceAbs(a, 0, h), h);
+    const limbs one(1, 1);
+    while (cmpAbs(r, d) < 0) {   // at most twice
+      addAbsInPlace(r, b);
+      subAbsInPlace(q, one);
+      trimAbs(q);
+    }
+    subAbsInPlace(r, d);
+    trimAbs(r);
+  }
+
+  // info: trimmed copy of x[from, to), clamped to the size of x
+  static limbs sliceAbs(const limbs& x, size_t from, size_t to) {
+    to = std::min(to, x.size());
+    limbs res;
+    if (from < to)
+      res.assign(x.begin() + from, x.begin() + to);
+    trimAbs(res);
+    return res;
+  }
+
+  // info: res = high * base^h + low for low < base^h. res may be high or low.
+  static void joinAbs(limbs& res, const limbs& high, const limbs& low, size_t h) {
+    limbs out(h + high.size(), 0);
+    std::copy(low.begin(), low.begin() + std::min(low.size(), h), out.begin());
+    std::copy(high.begin(), high.end(), out.begin() + h);
+    trimAbs(out);
+    res.swap(out);
+  }
+
+  // info: drops leading zero limbs
+  static void trimAbs(limbs& x) {
+    while (!x.empty() && !x.back())
+      x.pop_back();
   }
 
 };
 
 // ****************************************
+
+#endif
@@ -0,0 +1,203 @@
+/* Buffered ChaCha20 random generator for key generation */
+
+#ifndef CHACHARNG_CPP
+#define CHACHARNG_CPP
+
+#include <stdint.h>
+#include <cstring>
+#include <random>
+#include <atomic>
+#include <mutex>
+
+#include "LimbVector.cpp"
+
+// info: a fast-key-erasure ChaCha20 generator: each refill runs the ChaCha20 block function over
+//       BUFFER_BLOCKS counter values, keeps the first 32 bytes as the next key and hands out the rest
+//       as limbs, so earlier output cannot be recovered from a later state. one generator belongs to
+//       one thread; threadLocal() gives each thread its own, seeded from std::random_device once
+//       (8 reads), or derived from a fixed seed after useSeed() for reproducible runs.
+class ChaChaRng {
+public:
+  static const int BUFFER_BLOCKS = 8;   // 64-byte blocks generated per refill
+
+  // a generator keyed with 32 bytes, on one of 2^64 independent streams
+  ChaChaRng(const uint8_t[32], const uint64_t = 0);
+
+  // a generator keyed from std::random_device
+  static ChaChaRng fromEntropy();
+
+  limb_t nextLimb();                 // 64 uniform bits
+  void fill(limb_t*, const size_t);  // n uniform limbs
+  limb_t below(const limb_t);        // uniform in [0, bound), bound > 0
+
+  // the calling thread's generator. it follows the mode set by useSeed / useEntropy, switching on its
+  // next draw after a change
+  static ChaChaRng& threadLocal();
+
+  // deterministic mode: thread generators are rekeyed from seed, each on its own stream numbered in
+  // the order threads first draw. runs whose threads draw in the same order, e.g. key generation with
+  // one worker thread, repeat exactly.
+  static void useSeed(const uint64_t);
+  // default mode: thread generators are rekeyed from std::random_device
+  static void useEntropy();
+
+  // the ChaCha20 block function (20 rounds) on a 16-word state
+  static void block(const uint32_t[16], uint32_t[16]);
+
+private:
+  uint32_t key[8];
+  uint64_t stream;
+  limb_t buffer[(BUFFER_BLOCKS * 64 - 32) / 8];   // output of the last refill, minus the next key
+  size_t used;                                     // limbs of buffer already handed out
+
+  void refill();
+
+  struct SeedConfig {
+    std::mutex config_mutex;
+    std::atomic<uint64_t> epoch;   // bumped by every mode change
+    bool deterministic;
+    uint64_t seed;
+    uint64_t next_stream;
+    SeedConfig():
+      epoch(0), deterministic(false), seed(0), next_stream(0) {
+    }
+  };
+  static SeedConfig& config();
+};
+
+inline
+ChaChaRng::ChaChaRng(const uint8_t seed_key[32], const uint64_t stream):
+  stream(stream), used(sizeof(buffer) / sizeof(limb_t)) {
+  for (int i = 0; i < 8; i++)
+    key[i] = (uint32_t)seed_key[4 * i] | (uint32_t)seed_key[4 * i + 1] << 8
+           | (uint32_t)seed_key[4 * i + 2] << 16 | (uint32_t)seed_key[4 * i + 3] << 24;
+}
+
+inline
+ChaChaRng ChaChaRng::fromEntropy() {
+  std::random_device rd;
+  uint8_t seed_key[32];
+  for (int i = 0; i < 32; i += 4) {
+    uint32_t v = rd();
+    std::memcpy(seed_key + i, &v, 4);
+  }
+  return ChaChaRng(seed_key);
+}
+
+inline
+limb_t ChaChaRng::nextLimb() {
+  if (used == sizeof(buffer) / sizeof(limb_t))
+    refill();
+  return buffer[used++];
+}
+
+inline
+void ChaChaRng::fill(limb_t* out, const size_t n) {
+  for (size_t i = 0; i < n; i++)
+    out[i] = nextLimb();
+}
+
+// info: uniform value below bound by rejection: draws landing in the incomplete top copy of
+//       [0, bound) are redrawn, which happens with probability below 1/2
+inline
+limb_t ChaChaRng::below(const limb_t bound) {
+  limb_t limit = 0 - (0 - bound) % bound;   // largest multiple of bound that fits in 2^64, mod 2^64
+  while (1) {
+    limb_t v = nextLimb();
+    if (limit == 0 || v < limit)
+      return v % bound;
+  }
+}
+
+inline
+void ChaChaRng::block(const uint32_t in[16], uint32_t out[16]) {
+  uint32_t x[16];
+  std::memcpy(x, in, sizeof(x));
+  auto rotl = [](uint32_t v, int c) { return (v << c) | (v >> (32 - c)); };
+  auto quarter = [&](int a, int b, int c, int d) {
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+  };
+  for (int round = 0; round < 10; round++) {   // 10 double rounds: columns, then diagonals
+    quarter(0, 4, 8, 12);
+    quarter(1, 5, 9, 13);
+    quarter(2, 6, 10, 14);
+    quarter(3, 7, 11, 15);
+    quarter(0, 5, 10, 15);
+    quarter(1, 6, 11, 12);
+    quarter(2, 7, 8, 13);
+    quarter(3, 4, 9, 14);
+  }
+  for (int i = 0; i < 16; i++)
+    out[i] = x[i] + in[i];
+}
+
+// info: BUFFER_BLOCKS blocks under the current key with counters 0, 1, ...; the first 8 words
+//       become the next key, so the counter can restart at 0 on every refill
+inline
+void ChaChaRng::refill() {
+  uint32_t state[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };   // "expand 32-byte k"
+  std::memcpy(state + 4, key, sizeof(key));
+  state[14] = (uint32_t)stream;
+  state[15] = (uint32_t)(stream >> 32);
+  uint32_t out[BUFFER_BLOCKS * 16];
+  for (int b = 0; b < BUFFER_BLOCKS; b++) {
+    state[12] = (uint32_t)b;
+    state[13] = 0;
+    block(state, out + 16 * b);
+  }
+  std::memcpy(key, out, sizeof(key));
+  for (size_t i = 0; i < sizeof(buffer) / sizeof(limb_t); i++)   // words are little-endian in the stream
+    buffer[i] = (limb_t)out[8 + 2 * i] | (limb_t)out[8 + 2 * i + 1] << 32;
+  std::memset(out, 0, sizeof(out));
+  used = 0;
+}
+
+inline
+ChaChaRng::SeedConfig& ChaChaRng::config() {
+  static SeedConfig seed_config;
+  return seed_config;
+}
+
+inline
+ChaChaRng& ChaChaRng::threadLocal() {
+  static const uint8_t zero_key[32] = {};
+  static thread_local ChaChaRng rng(zero_key);
+  static thread_local uint64_t epoch = ~(uint64_t)0;   // none yet: seed on the first draw
+  SeedConfig& c = config();
+  if (epoch != c.epoch.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(c.config_mutex);
+    epoch = c.epoch.load(std::memory_order_relaxed);
+    if (c.deterministic) {
+      uint8_t seed_key[32] = {};
+      for (int i = 0; i < 8; i++)
+        seed_key[i] = (uint8_t)(c.seed >> (8 * i));
+      rng = ChaChaRng(seed_key, c.next_stream++);
+    }
+    else
+      rng = fromEntropy();
+  }
+  return rng;
+}
+
+inline
+void ChaChaRng::useSeed(const uint64_t seed) {
+  SeedConfig& c = config();
+  std::lock_guard<std::mutex> lock(c.config_mutex);
+  c.deterministic = true;
+  c.seed = seed;
+  c.next_stream = 0;
+  c.epoch++;
+}
+
+inline
+void ChaChaRng::useEntropy() {
+  SeedConfig& c = config();
+  std::lock_guard<std::mutex> lock(c.config_mutex);
+  c.deterministic = false;
+  c.epoch++;
+}
+
+#endif
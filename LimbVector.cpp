@@ -0,0 +1,262 @@
+/* Limb storage for BigInt: small-buffer vector with per-thread memory resources */
+
+#ifndef LIMBVECTOR_CPP
+#define LIMBVECTOR_CPP
+
+#include <stdint.h>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+typedef uint64_t limb_t;             // one limb of a BigInt magnitude
+
+// info: vector of limbs that keeps up to INLINE_LIMBS limbs inside the object, so small values
+//       (constants, counters, codebook digits) never touch the heap. larger magnitudes come from
+//       the memory resource that was current on the creating thread (see LimbArena), and each
+//       vector keeps using that resource for its lifetime. buffers only change hands (move, swap)
+//       between vectors of the same resource; otherwise the limbs are copied.
+class LimbVector {
+public:
+  static constexpr size_t INLINE_LIMBS = 4;
+
+  typedef limb_t value_type;
+  typedef limb_t* iterator;
+  typedef const limb_t* const_iterator;
+
+  LimbVector():
+    ptr(local), count(0), cap(INLINE_LIMBS), resource(threadResource()) {
+  }
+
+  explicit LimbVector(std::pmr::memory_resource* mr):
+    ptr(local), count(0), cap(INLINE_LIMBS), resource(mr) {
+  }
+
+  explicit LimbVector(size_t n, limb_t value = 0):
+    LimbVector() {
+    assign(n, value);
+  }
+
+  LimbVector(const limb_t* first, const limb_t* last):
+    LimbVector() {
+    assign(first, last);
+  }
+
+  LimbVector(const LimbVector& v):
+    LimbVector() {
+    assign(v.begin(), v.end());
+  }
+
+  LimbVector(LimbVector&& v) noexcept:
+    ptr(local), count(0), cap(INLINE_LIMBS), resource(v.resource) {
+    take(v);
+  }
+
+  ~LimbVector() {
+    release();
+  }
+
+  LimbVector& operator=(const LimbVector& v) {
+    if (this != &v)
+      assign(v.begin(), v.end());
+    return *this;
+  }
+
+  LimbVector& operator=(LimbVector&& v) noexcept {
+    if (this == &v)
+      return *this;
+    if (resource == v.resource || v.ptr == v.local) {
+      release();
+      take(v);
+    }
+    else
+      assign(v.begin(), v.end());
+    return *this;
+  }
+
+  // ----- element access -----
+  limb_t& operator[](size_t i) { return ptr[i]; }
+  const limb_t& operator[](size_t i) const { return ptr[i]; }
+  limb_t& back() { return ptr[count - 1]; }
+  const limb_t& back() const { return ptr[count - 1]; }
+  limb_t* data() { return ptr; }
+  const limb_t* data() const { return ptr; }
+  iterator begin() { return ptr; }
+  iterator end() { return ptr + count; }
+  const_iterator begin() const { return ptr; }
+  const_iterator end() const { return ptr + count; }
+
+  // ----- size -----
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  size_t capacity() const { return cap; }
+  std::pmr::memory_resource* memoryResource() const { return resource; }
+
+  void reserve(size_t n) {
+    if (n > cap)
+      grow(n);
+  }
+
+  void clear() {
+    count = 0;
+  }
+
+  void resize(size_t n) {
+    resize(n, 0);
+  }
+
+  void resize(size_t n, limb_t value) {
+    reserve(n);
+    if (n > count)
+      std::fill(ptr + count, ptr + n, value);
+    count = n;
+  }
+
+  void assign(size_t n, limb_t value) {
+    reserve(n);
+    std::fill(ptr, ptr + n, value);
+    count = n;
+  }
+
+  // source may point into this vector
+  void assign(const limb_t* first, const limb_t* last) {
+    size_t n = last - first;
+    if (n > cap) {
+      n = std::max(n, cap + cap / 2);
+      limb_t* bigger = allocate(n);
+      std::copy(first, last, bigger);   // before the old buffer (maybe the source) is released
+      release();
+      ptr = bigger;
+      cap = n;
+      count = last - first;
+      return;
+    }
+    std::copy(first, last, ptr);   // forward copy, first is never before ptr for overlapping ranges
+    count = n;
+  }
+
+  void push_back(limb_t value) {
+    if (count == cap)
+      grow(cap * 2);
+    ptr[count++] = value;
+  }
+
+  void pop_back() {
+    count--;
+  }
+
+  void swap(LimbVector& v) {
+    if (resource == v.resource && ptr != local && v.ptr != v.local) {
+      std::swap(ptr, v.ptr);
+      std::swap(count, v.count);
+      std::swap(cap, v.cap);
+      return;
+    }
+    LimbVector tmp(resource);
+    tmp.assign(begin(), end());
+    assign(v.begin(), v.end());
+    v.assign(tmp.begin(), tmp.end());
+  }
+
+  bool operator==(const LimbVector& v) const {
+    return count == v.count && std::equal(begin(), end(), v.begin());
+  }
+  bool operator!=(const LimbVector& v) const {
+    return !(*this == v);
+  }
+
+  // info: resource that heap buffers of vectors created on the calling thread come from
+  static std::pmr::memory_resource*& threadResource() {
+    static thread_local std::pmr::memory_resource* current = std::pmr::new_delete_resource();
+    return current;
+  }
+
+private:
+  limb_t* ptr;                          // local or a buffer from resource
+  size_t count;
+  size_t cap;
+  std::pmr::memory_resource* resource;  // where heap buffers come from and go back to
+  limb_t local[INLINE_LIMBS];
+
+  // info: moves the contents of v (same resource, or v inline) into this empty vector
+  void take(LimbVector& v) {
+    if (v.ptr == v.local) {
+      std::copy(v.local, v.local + v.count, local);
+      ptr = local;
+      cap = INLINE_LIMBS;
+    }
+    else {
+      ptr = v.ptr;
+      cap = v.cap;
+      resource = v.resource;
+      v.ptr = v.local;
+      v.cap = INLINE_LIMBS;
+    }
+    count = v.count;
+    v.count = 0;
+  }
+
+  void grow(size_t n) {
+    n = std::max(n, cap + cap / 2);
+    limb_t* bigger = allocate(n);
+    std::copy(ptr, ptr + count, bigger);
+    release();
+    ptr = bigger;
+    cap = n;
+  }
+
+  limb_t* allocate(size_t n) {
+    return static_cast<limb_t*>(resource->allocate(n * sizeof(limb_t), alignof(limb_t)));
+  }
+
+  void release() {
+    if (ptr != local)
+      resource->deallocate(ptr, cap * sizeof(limb_t), alignof(limb_t));
+    ptr = local;
+    cap = INLINE_LIMBS;
+  }
+};
+
+// info: scoped per-thread arena for BigInt limbs. while it is alive, vectors created on this thread take
+//       their heap buffers from a monotonic arena instead of the global allocator; the whole arena is
+//       dropped at once when the scope ends. the first arena on a thread carves from a per-thread block
+//       that is kept between scopes, so a steady stream of scoped operations does not call malloc at all.
+// note: every BigInt created inside the scope must be destroyed before the scope ends.
+class LimbArena {
+public:
+  static constexpr size_t THREAD_BLOCK_BYTES = 1 << 18;
+
+  LimbArena():
+    previous(LimbVector::threadResource()) {
+    if (depth()++ == 0)
+      arena.emplace(threadBlock(), THREAD_BLOCK_BYTES, std::pmr::new_delete_resource());
+    else   // an outer arena on this thread already carves from the block
+      arena.emplace(std::pmr::new_delete_resource());
+    LimbVector::threadResource() = &*arena;
+  }
+
+  ~LimbArena() {
+    LimbVector::threadResource() = previous;
+    depth()--;
+  }
+
+  LimbArena(const LimbArena&) = delete;
+  LimbArena& operator=(const LimbArena&) = delete;
+
+private:
+  std::optional<std::pmr::monotonic_buffer_resource> arena;
+  std::pmr::memory_resource* previous;
+
+  static int& depth() {
+    static thread_local int active = 0;
+    return active;
+  }
+
+  static char* threadBlock() {
+    static thread_local std::unique_ptr<char[]> block(new char[THREAD_BLOCK_BYTES]);
+    return block.get();
+  }
+};
+
+#endif
@@ -0,0 +1,74 @@
+/* Read-only memory-mapped file */
+
+#ifndef MAPPEDFILE_CPP
+#define MAPPEDFILE_CPP
+
+#include <string>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// info: maps a whole file read-only into memory for the lifetime of the object, so any byte
+//       range can be read straight from the page cache without reading the rest of the file.
+// params: filename to map
+class MappedFile {
+public:
+  explicit MappedFile(const std::string&);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return bytes; }   // first byte of the file (null for an empty file)
+  size_t size() const { return length; }       // file size in bytes
+
+  // hint the kernel that access is random, so it does not read ahead of the requested pages
+  void adviseRandom() const;
+
+private:
+  const char* bytes;
+  size_t length;
+};
+
+
+inline
+MappedFile::MappedFile(const std::string& fname):
+  bytes(nullptr), length(0) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::range_error("Input file could not be opened.");
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::range_error("Input file could not be opened.");
+  }
+  length = (size_t)info.st_size;
+
+  if (length > 0) {
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      throw std::range_error("Input file could not be mapped.");
+    }
+    bytes = static_cast<const char*>(mapped);
+  }
+  ::close(fd);   // the mapping stays valid after the descriptor is closed
+}
+
+inline
+MappedFile::~MappedFile() {
+  if (bytes)
+    ::munmap(const_cast<char*>(bytes), length);
+}
+
+inline
+void MappedFile::adviseRandom() const {
+  if (bytes)
+    ::madvise(const_cast<char*>(bytes), length, MADV_RANDOM);
+}
+
+#endif
@@ -0,0 +1,225 @@
+/* Montgomery multiplication context for BigInt */
+
+#ifndef MONTGOMERY_CPP
+#define MONTGOMERY_CPP
+
+#include <vector>
+#include <stdexcept>
+
+#include "BigInt.cpp"
+
+// info: sliding-window recoding of a non-negative exponent. the exponent is scanned once,
+//       most significant bit first, into odd window digits each preceded by the number of
+//       squarings to perform before multiplying by that digit's power. keep one per exponent
+//       that is used repeatedly (e.g. RSA keys) so exponentiation never re-scans it.
+struct SlidingWindowExponent {
+  struct Step {
+    int squarings;    // squarings to perform before the multiply
+    int digit;        // odd window value, multiply by base^digit
+  };
+
+  int window;               // window width in bits
+  std::vector<Step> steps;  // window digits, most significant first
+  int trailing;             // squarings left after the last digit
+
+  SlidingWindowExponent():
+    window(1), trailing(0) {
+  }
+
+  SlidingWindowExponent(const BigInt& exp):
+    window(windowFor(exp.bitLength())), trailing(0) {
+    int squarings = 0;
+    for (int i = exp.bitLength() - 1; i >= 0; ) {
+      if (!exp.testBit(i)) {
+        squarings++;
+        i--;
+        continue;
+      }
+      int j = std::max(i - window + 1, 0);
+      while (!exp.testBit(j))
+        j++;
+      int digit = 0;
+      for (int b = i; b >= j; b--)
+        digit = (digit << 1) | (int)exp.testBit(b);
+      squarings += i - j + 1;
+      Step step = { squarings, digit };
+      steps.push_back(step);
+      squarings = 0;
+      i = j - 1;
+    }
+    trailing = squarings;
+  }
+
+  // info: window width for an exponent of the given size, balancing the 2^(w-1) table
+  //       entries against the multiplies saved per exponent bit
+  static int windowFor(int bits) {
+    if (bits > 671) return 6;
+    if (bits > 239) return 5;
+    if (bits > 79) return 4;
+    if (bits > 23) return 3;
+    return 1;
+  }
+};
+
+// info: precomputed Montgomery reduction data for a fixed odd modulus N.
+//       R is 2^(64k) where k is the limb count of N, so reduction works one limb at a
+//       time with a single-limb inverse instead of long divisions. Build once per modulus
+//       and reuse it for every modular multiplication by that modulus.
+// params: modulus N, which must be odd and greater than 1.
+struct Montgomery {
+  BigInt N;         // modulus
+  limb_t n0inv;     // -N^-1 mod 2^64
+  BigInt R2;        // R^2 mod N, used to move values into Montgomery form
+  BigInt one;       // R mod N, the Montgomery form of 1
+  int k;            // limb count of N, R = 2^(64k)
+
+  Montgomery():
+    n0inv(0), k(0) {
+  }
+
+  Montgomery(const BigInt& modulus):
+    N(modulus), k((int)modulus.a.size()) {
+    if (!applicable(N))
+      throw std::invalid_argument("Montgomery modulus must be odd and greater than 1.");
+
+    // newton iteration doubles the number of correct low bits of N0^-1 each step (3 -> 96)
+    limb_t inv = N.a[0];
+    for (int i = 0; i < 5; i++)
+      inv *= 2 - N.a[0] * inv;
+    n0inv = 0 - inv;
+
+    one = limbPower(k) % N;
+    R2 = limbPower(2 * k) % N;
+  }
+
+  // info: rebuilds a context from previously computed parts (e.g. a saved key) without any arithmetic
+  // params: modulus N, -N^-1 mod 2^64, R^2 mod N, R mod N
+  Montgomery(const BigInt& modulus, limb_t n0inv, const BigInt& R2, const BigInt& one):
+    N(modulus), n0inv(n0inv), R2(R2), one(one), k((int)modulus.a.size()) {
+    if (!applicable(N) || N.a[0] * n0inv != (limb_t)-1 || R2 >= N || one >= N)
+      throw std::invalid_argument("Montgomery parts do not match the modulus.");
+  }
+
+  // info: true if a Montgomery context can be built for modulus m
+  static bool applicable(const BigInt& m) {
+    return m.sign > 0 && m.isOdd() && m > BigInt(1);
+  }
+
+  // info: converts a (0 <= a < N) into Montgomery form: a * R mod N
+  BigInt toMont(const BigInt& a) const {
+    return redc(a * R2);
+  }
+
+  // info: converts a Montgomery-form value back to its ordinary residue
+  BigInt fromMont(const BigInt& a) const {
+    return redc(a);
+  }
+
+  // info: Montgomery product of two Montgomery-form values: a * b * R^-1 mod N
+  BigInt mul(const BigInt& a, const BigInt& b) const {
+    BigInt res;
+    BigInt::limbs scratch;
+    mulInto(res, a, b, scratch);
+    return res;
+  }
+
+  // info: res = a * b * R^-1 mod N without allocating once res and scratch have grown to size.
+  //       res may be a or b; scratch holds the double-width product and is reused across calls.
+  void mulInto(BigInt& res, const BigInt& a, const BigInt& b, BigInt::limbs& scratch) const {
+    BigInt::mulAbsInto(scratch, a.a, b.a);
+    redcInto(res, scratch);
+  }
+
+  // info: computes (a^b) mod N with sliding-window exponentiation
+  // params: any base a, non-negative exponent b
+  BigInt pow(const BigInt& a, const BigInt& b) const {
+    return pow(a, SlidingWindowExponent(b));
+  }
+
+  // info: computes (a^b) mod N for an exponent that has already been recoded into windows
+  // params: any base a, recoded exponent b
+  BigInt pow(const BigInt& a, const SlidingWindowExponent& b) const {
+    BigInt f = powMont(a, b);
+    BigInt::limbs scratch(f.a);
+    redcInto(f, scratch);   // out of montgomery form
+    return f;
+  }
+
+  // info: a^b in montgomery form (a^b * R mod N), for callers that keep working in that form
+  // params: any base a, recoded exponent b
+  BigInt powMont(const BigInt& a, const SlidingWindowExponent& b) const {
+    if (b.steps.empty())
+      return one;
+    BigInt::limbs scratch;
+    BigInt x;
+    BigInt::modInto(x, a, N);
+    if (x.sign < 0)
+      x += N;
+    mulInto(x, x, R2, scratch);   // to montgomery form
+
+    // odd powers x^1, x^3, ..., x^(2^w - 1) in montgomery form
+    std::vector<BigInt> table(1 << (b.window - 1));
+    table[0] = x;
+    if (table.size() > 1) {
+      BigInt x2;
+      mulInto(x2, x, x, scratch);
+      for (size_t i = 1; i < table.size(); i++)
+        mulInto(table[i], table[i - 1], x2, scratch);
+    }
+
+    // the loop only reuses f and scratch, so it makes no allocations (alloc_check.cpp, make check)
+    BigInt f = table[b.steps[0].digit >> 1];
+    f.a.reserve(N.a.size() + 1);
+    for (size_t s = 1; s < b.steps.size(); s++) {
+      for (int i = 0; i < b.steps[s].squarings; i++)
+        mulInto(f, f, f, scratch);
+      mulInto(f, f, table[b.steps[s].digit >> 1], scratch);
+    }
+    for (int i = 0; i < b.trailing; i++)
+      mulInto(f, f, f, scratch);
+    return f;
+  }
+
+  // info: montgomery reduction of T (0 <= T < N * R): returns T * R^-1 mod N.
+  BigInt redc(const BigInt& T) const {
+    BigInt::limbs t(T.a);
+    BigInt res;
+    redcInto(res, t);
+    return res;
+  }
+
+  // info: montgomery reduction in place: t holds T on entry and is used as the work area, res
+  //       receives T * R^-1 mod N. each step clears the lowest remaining limb by adding a multiple of N.
+  void redcInto(BigInt& res, BigInt::limbs& t) const {
+    t.resize(2 * k + 1, 0);
+    for (int i = 0; i < k; i++) {
+      limb_t m = t[i] * n0inv;
+      limb_t carry = 0;
+      for (int j = 0; j < k; j++) {
+        dlimb_t cur = (dlimb_t)m * N.a[j] + t[i + j] + carry;
+        t[i + j] = (limb_t)cur;
+        carry = (limb_t)(cur >> limb_bits);
+      }
+      for (int j = i + k; carry; j++) {
+        t[j] += carry;
+        carry = t[j] < carry;
+      }
+    }
+
+    res.sign = 1;
+    res.a.assign(t.begin() + k, t.end());
+    res.trim();
+    if (res >= N)
+      res -= N;
+  }
+
+  // info: 2^(64 * count)
+  static BigInt limbPower(int count) {
+    BigInt res;
+    res.a.assign(count, 0);
+    res.a.push_back(1);
+    return res;
+  }
+};
+
+#endif
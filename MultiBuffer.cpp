@@ -0,0 +1,201 @@
+/* Multi-buffer Montgomery exponentiation: several bases under one modulus and exponent, in SIMD lanes */
+
+#ifndef MULTIBUFFER_CPP
+#define MULTIBUFFER_CPP
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "BigInt.cpp"
+#include "Montgomery.cpp"
+#include "BasecaseKernels.cpp"
+
+// info: runs up to LANES modular exponentiations that share a modulus N and an exponent in lockstep:
+//       every lane performs the same squarings and table multiplies, only the data differ. values are
+//       held as base 2^52 digits in structure-of-arrays layout (digit j of all lanes side by side), so
+//       one AVX-512 IFMA instruction advances the same digit product in all eight lanes. usable() is
+//       false on CPUs without IFMA and for moduli above MAX_DIGITS digits; callers then exponentiate
+//       one value at a time on Montgomery.
+// params: odd modulus N > 1
+struct MultiBufferMontgomery {
+  static const int LANES = 8;              // 64-bit lanes of a 512-bit vector
+  static const int MAX_DIGITS = 160;       // keeps 4 * MAX_DIGITS column terms below 2^62 in a 64-bit lane
+
+  BigInt N;
+  int k;                          // base 2^52 digits of N; R = 2^(52k)
+  uint64_t n0inv;                 // -N^-1 mod 2^52
+  std::vector<uint64_t> n_digits; // digits of N
+  std::vector<uint64_t> r2;       // R^2 mod N, in every lane
+  std::vector<uint64_t> unit;     // plain 1, in every lane: multiplying by it leaves montgomery form
+
+  MultiBufferMontgomery():
+    k(0), n0inv(0) {
+  }
+
+  MultiBufferMontgomery(const BigInt& modulus):
+    N(modulus), k(0), n0inv(0) {
+    if (!cpuSupported() || !Montgomery::applicable(modulus))
+      return;
+    int digits = (modulus.bitLength() + 51) / 52;
+    if (digits > MAX_DIGITS)
+      return;
+    k = digits;
+    n_digits.assign((64 * N.a.size() + 51) / 52, 0);
+    toDigits52(n_digits.data(), N.a.data(), N.a.size());
+    n_digits.resize(k);
+
+    limb_t inv = N.a[0];   // newton iteration for N^-1 mod 2^64, which also holds mod 2^52
+    for (int i = 0; i < 5; i++)
+      inv *= 2 - N.a[0] * inv;
+    n0inv = (0 - inv) & DIGIT_MASK;
+
+    BigInt R2 = (BigInt(1) << (104 * k)) % N;
+    r2.assign((size_t)k * LANES, 0);
+    unit.assign((size_t)k * LANES, 0);
+    std::vector<uint64_t> digits_r2((64 * R2.a.size() + 51) / 52, 0);
+    toDigits52(digits_r2.data(), R2.a.data(), R2.a.size());
+    for (int j = 0; j < k; j++)
+      for (int l = 0; l < LANES; l++)
+        r2[j * LANES + l] = j < (int)digits_r2.size() ? digits_r2[j] : 0;
+    for (int l = 0; l < LANES; l++)
+      unit[l] = 1;
+  }
+
+  // info: true once the context was built for this CPU and modulus
+  bool usable() const {
+    return k > 0;
+  }
+
+  // info: true if the CPU runs the AVX-512 IFMA lane kernel
+  static bool cpuSupported() {
+#ifdef BASECASE_X86
+    static const bool supported = [] {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  // info: out[i] = bases[i]^exp mod N for count <= LANES bases in [0, N). unused lanes run on zero.
+  void pow(BigInt* out, const BigInt* bases, const size_t count, const SlidingWindowExponent& exp) const {
+    const size_t size = (size_t)k * LANES;
+    std::vector<uint64_t> x(size, 0), f(size), digits;
+    for (size_t l = 0; l < count; l++) {   // into lanes, then into montgomery form
+      digits.assign(std::max<size_t>((64 * bases[l].a.size() + 51) / 52, k), 0);
+      toDigits52(digits.data(), bases[l].a.data(), bases[l].a.size());
+      for (int j = 0; j < k; j++)
+        x[j * LANES + l] = digits[j];
+    }
+    mul(x.data(), x.data(), r2.data());
+
+    if (exp.steps.empty())
+      f = unit;
+    else {
+      // odd powers x^1, x^3, ..., x^(2^w - 1) of every lane
+      std::vector<std::vector<uint64_t> > table((size_t)1 << (exp.window - 1), x);
+      if (table.size() > 1) {
+        std::vector<uint64_t> x2(size);
+        mul(x2.data(), x.data(), x.data());
+        for (size_t i = 1; i < table.size(); i++)
+          mul(table[i].data(), table[i - 1].data(), x2.data());
+      }
+      f = table[exp.steps[0].digit >> 1];
+      for (size_t s = 1; s < exp.steps.size(); s++) {
+        for (int i = 0; i < exp.steps[s].squarings; i++)
+          mul(f.data(), f.data(), f.data());
+        mul(f.data(), f.data(), table[exp.steps[s].digit >> 1].data());
+      }
+      for (int i = 0; i < exp.trailing; i++)
+        mul(f.data(), f.data(), f.data());
+      mul(f.data(), f.data(), unit.data());   // out of montgomery form
+    }
+
+    for (size_t l = 0; l < count; l++) {   // out of lanes
+      BigInt& res = out[l];
+      res = BigInt();
+      res.a.assign(((size_t)k * 52 + 63) / 64, 0);
+      for (int j = 0; j < k; j++) {
+        size_t bit = (size_t)j * 52, limb = bit / 64, shift = bit % 64;
+        res.a[limb] |= f[j * LANES + l] << shift;
+        if (shift > 12 && limb + 1 < res.a.size())
+          res.a[limb + 1] |= f[j * LANES + l] >> (64 - shift);
+      }
+      res.trim();
+    }
+  }
+
+  // info: res = a * b * R^-1 mod N in every lane, for lane values below N. res may be a or b.
+  void mul(uint64_t* res, const uint64_t* a, const uint64_t* b) const {
+#ifdef BASECASE_X86
+    mulIfma(res, a, b);
+#endif
+  }
+
+private:
+  static const uint64_t DIGIT_MASK = (1ULL << 52) - 1;
+
+#ifdef BASECASE_X86
+  // info: word-serial montgomery product. round i adds a * b_i and m * N, with m chosen per lane so the
+  //       lowest live column becomes divisible by 2^52. instead of shifting the accumulator down, the
+  //       next round starts one column higher, and that column takes the carry. the k + 1 columns left
+  //       at the end hold a value below 2N; they are normalized and N is subtracted where it fits.
+  __attribute__((target("avx512f,avx512ifma")))
+  void mulIfma(uint64_t* res, const uint64_t* a, const uint64_t* b) const {
+    alignas(64) uint64_t t[(2 * MAX_DIGITS + 2) * LANES];
+    std::memset(t, 0, sizeof(uint64_t) * (2 * k + 2) * LANES);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ninv = _mm512_set1_epi64((long long)n0inv);
+    for (int i = 0; i < k; i++) {
+      uint64_t* col = t + (size_t)i * LANES;
+      __m512i bi = _mm512_loadu_si512(b + (size_t)i * LANES);
+      for (int j = 0; j < k; j++) {
+        __m512i aj = _mm512_loadu_si512(a + (size_t)j * LANES);
+        uint64_t* lo = col + (size_t)j * LANES;
+        _mm512_store_si512(lo, _mm512_madd52lo_epu64(_mm512_load_si512(lo), aj, bi));
+        _mm512_store_si512(lo + LANES, _mm512_madd52hi_epu64(_mm512_load_si512(lo + LANES), aj, bi));
+      }
+      __m512i m = _mm512_madd52lo_epu64(zero, _mm512_load_si512(col), ninv);
+      for (int j = 0; j < k; j++) {
+        __m512i nj = _mm512_set1_epi64((long long)n_digits[j]);
+        uint64_t* lo = col + (size_t)j * LANES;
+        _mm512_store_si512(lo, _mm512_madd52lo_epu64(_mm512_load_si512(lo), nj, m));
+        _mm512_store_si512(lo + LANES, _mm512_madd52hi_epu64(_mm512_load_si512(lo + LANES), nj, m));
+      }
+      __m512i carry = _mm512_srli_epi64(_mm512_load_si512(col), 52);   // the low 52 bits are zero now
+      _mm512_store_si512(col + LANES, _mm512_add_epi64(_mm512_load_si512(col + LANES), carry));
+    }
+
+    const uint64_t* top = t + (size_t)k * LANES;   // k + 1 columns
+    alignas(64) uint64_t norm[(MAX_DIGITS + 1) * LANES];
+    __m512i carry = zero;
+    const __m512i mask = _mm512_set1_epi64((long long)DIGIT_MASK);
+    for (int j = 0; j <= k; j++) {
+      __m512i v = _mm512_add_epi64(_mm512_load_si512(top + (size_t)j * LANES), carry);
+      _mm512_store_si512(norm + (size_t)j * LANES, _mm512_and_si512(v, mask));
+      carry = _mm512_srli_epi64(v, 52);
+    }
+    // diff = norm - N; lanes whose subtraction does not borrow take it
+    alignas(64) uint64_t diff[MAX_DIGITS * LANES];
+    __m512i borrow = zero;
+    for (int j = 0; j < k; j++) {
+      __m512i v = _mm512_sub_epi64(_mm512_load_si512(norm + (size_t)j * LANES),
+                                   _mm512_add_epi64(_mm512_set1_epi64((long long)n_digits[j]), borrow));
+      _mm512_store_si512(diff + (size_t)j * LANES, _mm512_and_si512(v, mask));
+      borrow = _mm512_srli_epi64(v, 63);
+    }
+    __m512i high = _mm512_sub_epi64(_mm512_load_si512(norm + (size_t)k * LANES), borrow);
+    __mmask8 keep = _mm512_cmpeq_epi64_mask(_mm512_srli_epi64(high, 63), _mm512_set1_epi64(1));   // norm < N
+    for (int j = 0; j < k; j++) {
+      __m512i v = _mm512_mask_blend_epi64(keep, _mm512_load_si512(diff + (size_t)j * LANES),
+                                          _mm512_load_si512(norm + (size_t)j * LANES));
+      _mm512_storeu_si512(res + (size_t)j * LANES, v);
+    }
+  }
+#endif
+};
+
+#endif
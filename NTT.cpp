@@ -0,0 +1,168 @@
+/* Number-theoretic transform multiplication of limb arrays */
+
+#ifndef NTT_CPP
+#define NTT_CPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "LimbVector.cpp"
+
+// info: one NTT prime p = c * 2^k + 1 below 2^62 with its Montgomery constants. residues are reduced
+//       with a 64-bit Montgomery step, so no butterfly needs a hardware division.
+struct NttPrime {
+  limb_t p;        // the prime
+  limb_t nprime;   // -p^-1 mod 2^64
+  limb_t r2;       // 2^128 mod p
+  limb_t g;        // primitive root mod p
+
+  NttPrime(limb_t p, limb_t g):
+    p(p), g(g) {
+    limb_t inv = p;   // newton iteration, p * p = 1 mod 8 gives 3 correct bits
+    for (int i = 0; i < 5; i++)
+      inv *= 2 - p * inv;
+    nprime = 0 - inv;
+    limb_t r = (limb_t)(((unsigned __int128)1 << 64) % p);
+    r2 = (limb_t)((unsigned __int128)r * r % p);
+  }
+
+  // info: a * b * 2^-64 mod p for any 64-bit a and b < p
+  limb_t mul(limb_t a, limb_t b) const {
+    unsigned __int128 t = (unsigned __int128)a * b;
+    limb_t m = (limb_t)t * nprime;
+    limb_t u = (limb_t)((t + (unsigned __int128)m * p) >> 64);
+    return u >= p ? u - p : u;
+  }
+
+  // info: montgomery form of a plain residue: a * 2^64 mod p
+  limb_t toMont(limb_t a) const {
+    return mul(a % p, r2);
+  }
+
+  limb_t add(limb_t a, limb_t b) const {
+    limb_t s = a + b;
+    return s >= p ? s - p : s;
+  }
+
+  limb_t sub(limb_t a, limb_t b) const {
+    return a >= b ? a - b : a + p - b;
+  }
+
+  // info: base^exp mod p for a plain base, the result in plain form
+  limb_t pow(limb_t base, limb_t exp) const {
+    unsigned __int128 res = 1, b = base % p;
+    for (; exp; exp >>= 1) {
+      if (exp & 1)
+        res = res * b % p;
+      b = b * b % p;
+    }
+    return (limb_t)res;
+  }
+
+  // info: in-place transform of n = 2^log residues. the twiddles are in montgomery form, so residues keep
+  //       whatever form they come in. the inverse transform leaves every value multiplied by n.
+  void transform(std::vector<limb_t>& a, int log, bool inverse, std::vector<limb_t>& twiddles) const {
+    size_t n = (size_t)1 << log;
+    for (size_t i = 1, j = 0; i < n; i++) {   // bit-reversal permutation
+      size_t bit = n >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+      if (i < j)
+        std::swap(a[i], a[j]);
+    }
+    twiddles.resize(n / 2);
+    for (size_t len = 2; len <= n; len <<= 1) {
+      limb_t w = pow(g, (p - 1) / len);
+      if (inverse)
+        w = pow(w, p - 2);
+      limb_t w_mont = toMont(w);
+      twiddles[0] = toMont(1);
+      for (size_t j = 1; j < len / 2; j++)
+        twiddles[j] = mul(twiddles[j - 1], w_mont);   // stays in montgomery form
+      for (size_t i = 0; i < n; i += len) {
+        for (size_t j = 0; j < len / 2; j++) {
+          limb_t u = a[i + j];
+          limb_t v = mul(a[i + j + len / 2], twiddles[j]);
+          a[i + j] = add(u, v);
+          a[i + j + len / 2] = sub(u, v);
+        }
+      }
+    }
+  }
+
+  // info: cyclic convolution of x and y modulo p in out (size 2^log). out[i] is exact once the
+  //       true coefficient is below p, which three primes and CRT take care of. a square (x and y
+  //       the same range) transforms once.
+  void convolve(std::vector<limb_t>& out, const limb_t* x, size_t xn, const limb_t* y, size_t yn, int log,
+                std::vector<limb_t>& other, std::vector<limb_t>& twiddles) const {
+    size_t n = (size_t)1 << log;
+    bool square = x == y && xn == yn;
+    out.assign(n, 0);
+    for (size_t i = 0; i < xn; i++)   // into montgomery form, which also reduces the limb mod p
+      out[i] = mul(x[i], r2);
+    transform(out, log, false, twiddles);
+    if (!square) {
+      other.assign(n, 0);
+      for (size_t i = 0; i < yn; i++)
+        other[i] = mul(y[i], r2);
+      transform(other, log, false, twiddles);
+    }
+    const std::vector<limb_t>& factor = square ? out : other;
+    for (size_t i = 0; i < n; i++)
+      out[i] = mul(out[i], factor[i]);
+    transform(out, log, true, twiddles);
+    // out of montgomery form and divided by n in one multiply
+    limb_t scale = pow(n % p, p - 2);
+    for (size_t i = 0; i < n; i++)
+      out[i] = mul(out[i], scale);
+  }
+};
+
+// info: res[0 .. xn + yn) = x * y by convolution modulo three 62-bit primes and garner's CRT
+//       recombination. every coefficient of the product of 64-bit limbs is below n * 2^128 < p1 p2 p3,
+//       so the three residues determine it exactly. res must not overlap x or y.
+inline
+void nttMultiply(limb_t* res, const limb_t* x, size_t xn, const limb_t* y, size_t yn) {
+  static const NttPrime p1(4179340454199820289ULL, 3);   // 29 * 2^57 + 1
+  static const NttPrime p2(2485986994308513793ULL, 5);   // 69 * 2^55 + 1, transforms up to 2^55
+  static const NttPrime p3(1945555039024054273ULL, 5);   // 27 * 2^56 + 1
+  // garner constants in montgomery form: p1^-1 mod p2, p1 mod p3, (p1 p2)^-1 mod p3
+  static const limb_t p1_inv_p2 = p2.toMont(p2.pow(p1.p % p2.p, p2.p - 2));
+  static const limb_t p1_mod_p3 = p3.toMont(p1.p % p3.p);
+  static const limb_t p12_inv_p3 = p3.toMont(p3.pow((limb_t)((unsigned __int128)p1.p * p2.p % p3.p), p3.p - 2));
+  static const unsigned __int128 p12 = (unsigned __int128)p1.p * p2.p;
+
+  size_t count = xn + yn - 1;   // coefficients of the product
+  int log = 0;
+  while (((size_t)1 << log) < count)
+    log++;
+
+  std::vector<limb_t> r1, r2, r3, other, twiddles;
+  p1.convolve(r1, x, xn, y, yn, log, other, twiddles);
+  p2.convolve(r2, x, xn, y, yn, log, other, twiddles);
+  p3.convolve(r3, x, xn, y, yn, log, other, twiddles);
+
+  // coefficient i = r1 + v2 p1 + v3 p1 p2 (below 2^184), added at limb i with a two-limb carry
+  limb_t carry0 = 0, carry1 = 0;
+  for (size_t i = 0; i < count; i++) {
+    limb_t v2 = p2.mul(r2[i] + 4 * p2.p - r1[i], p1_inv_p2);
+    limb_t v3 = p3.mul(r3[i] + 4 * p3.p - r1[i] - p3.mul(v2, p1_mod_p3), p12_inv_p3);
+
+    unsigned __int128 low = (unsigned __int128)v2 * p1.p + r1[i];
+    unsigned __int128 mid = (unsigned __int128)v3 * (limb_t)p12;
+    unsigned __int128 high = (unsigned __int128)v3 * (limb_t)(p12 >> 64);
+    unsigned __int128 s0 = (unsigned __int128)(limb_t)low + (limb_t)mid;
+    unsigned __int128 s1 = (low >> 64) + (mid >> 64) + (limb_t)high + (s0 >> 64);
+    limb_t s2 = (limb_t)(high >> 64) + (limb_t)(s1 >> 64);
+
+    unsigned __int128 t0 = (unsigned __int128)(limb_t)s0 + carry0;
+    unsigned __int128 t1 = (unsigned __int128)(limb_t)s1 + carry1 + (t0 >> 64);
+    res[i] = (limb_t)t0;
+    carry0 = (limb_t)t1;
+    carry1 = s2 + (limb_t)(t1 >> 64);
+  }
+  res[count] = carry0;
+}
+
+#endif
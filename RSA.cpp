@@ -6,86 +6,219 @@
 #include <random>
 #include <algorithm>
 #include <sstream>
-#include <map>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <array>
+#include <cstring>
+#include <condition_variable>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "BigInt.cpp"
+#include "Montgomery.cpp"
+#include "Barrett.cpp"
+#include "ThreadPool.cpp"
+#include "MappedFile.cpp"
+#include "ChaChaRng.cpp"
+#include "MultiBuffer.cpp"
+
+
+// info: builds a 256-entry char to number table at compile time, -1 marks unmapped chars
+// params: chars in number order, how many there are, the null char (maps to 0),
+//         whether lowercase letters fold onto the uppercase numbers
+constexpr std::array<signed char, 256> buildCodebookTable(const char* chars, int count, char null_char, bool fold_case) {
+  std::array<signed char, 256> table{};
+  for (int c = 0; c < 256; c++)
+    table[c] = -1;
+  for (int i = 0; i < count; i++)
+    table[(unsigned char)chars[i]] = (signed char)(fold_case ? i % 26 : i);
+  table[(unsigned char)null_char] = 0;
+  return table;
+}
+
+// info: keeps verified primes of a fixed set of digit sizes ready for RSA key creation. a background
+//       thread refills a size once its stock has dropped to the low watermark and stops at the high
+//       watermark. RSA constructors given the pool take p and q from it and only fall back to a prime
+//       search on a miss, so key creation does not wait on the search while the pool keeps up.
+// params: digit sizes to stock, low and high watermarks (primes kept per size, low < high)
+class PrimePool {
+public:
+  PrimePool(const std::vector<int>&, const size_t = 2, const size_t = 8);
+  ~PrimePool();
+
+  PrimePool(const PrimePool&) = delete;
+  PrimePool& operator=(const PrimePool&) = delete;
+
+  bool take(const int, BigInt&);            // pop a prime of a digit size, false on a miss
+  size_t available(const int) const;        // primes currently stocked for a digit size
+
+  // takes served from the pool and takes that found it empty (or the size not stocked)
+  size_t hits() const { return hit_count; }
+  size_t misses() const { return miss_count; }
+
+private:
+  struct Stock {
+    int digits;                     // digit size of the primes in this stock
+    LockFreeQueue<BigInt> primes;   // verified primes, taken lock-free by any thread
+    std::atomic<bool> refilling;    // set at the low watermark, cleared at the high watermark
+    Stock(int digits, size_t capacity):
+      digits(digits), primes(capacity), refilling(true) {
+    }
+  };
 
+  std::vector<std::unique_ptr<Stock> > stocks;
+  size_t low_watermark, high_watermark;
+  std::atomic<size_t> hit_count, miss_count;
+  std::atomic<bool> stopping;
+  std::mutex wake_mutex;
+  std::condition_variable wake_cv;
+  std::thread filler;
+
+  Stock* find(const int) const;
+  bool needsFill() const;
+  void requestFill(Stock&);
+  void fill();
+};
 
 // info: this class allows for the implementation of an RSA crypto-system
 // params: user passes an integer to constructor, indicating how many decimal digits 
-//         the prime numbers of the RSA system should be.
+//         the prime numbers of the RSA system should be, and optionally how many worker
+//         threads the system may use (0 picks the hardware concurrency).
 class RSA {
+  friend class PrimePool;   // the pool's filler thread runs the prime search
+
   static const int MIN_DIGITS = 3;                    // Minimum number of digits for RSA primes
-  static const int MAX_DIGITS = 300;                  // Max number of digits for RSA primes
-  static const int BLOCK_SIZE_PLAINTEXT_BYTES = 3;    // # of bytes in plaintext blocks
-  static const int BLOCK_SIZE_CIPHERTEXT_BYTES = 32;   // # of bytes in ciphertext blocks
+  static const int MAX_DIGITS = 1000;                 // Max number of digits for RSA primes
+  static const int BLOCK_SIZE_PLAINTEXT_BYTES = 3;    // # of bytes in trigraph plaintext blocks
+  static const int SMALL_PRIME_COUNT = 2048;          // # of odd primes used to sieve prime candidates
+  static const int SIEVE_WINDOW = 4096;               // # of odd prime candidates sieved at once
+  static const int TRIAL_DIVISION_PRIMES = 64;        // # of small odd primes isProbablePrime divides by
+  static const int STREAM_CHUNK_BYTES = 1 << 20;      // default # of input bytes per streaming chunk
+  static const int STREAM_QUEUE_DEPTH = 2;            // chunks buffered between streaming stages
+  static const int CONTAINER_VERSION = 1;             // version written to binary ciphertext containers
+  static const int CONTAINER_HEADER_BYTES = 24;       // size of the binary ciphertext container header
+  static const int KEY_FILE_VERSION = 1;              // version written to saved key files
+  static const int PUBLIC_EXPONENT = 65537;           // standard public key e, used whenever it is valid
 
 public:
-  // Initialize RSA crypto-system
-  RSA(const int);
+  // how plaintext is cut into blocks. TRIGRAPH_BLOCKS: 3 letters per block, read as a base-52 trigraph.
+  // BYTE_BLOCKS: as many arbitrary bytes per block as fit below the modulus n.
+  enum BlockMode { TRIGRAPH_BLOCKS, BYTE_BLOCKS };
+
+  // how ciphertext files are written. TEXT_FORMAT: base-52 letters, no header. BINARY_FORMAT: a header
+  // followed by fixed-width big-endian residues. decryption detects the format from the file itself.
+  enum FileFormat { TEXT_FORMAT, BINARY_FORMAT };
+
+  // Initialize RSA crypto-system, optionally taking p and q from a prime pool
+  RSA(const int, const unsigned = 0, PrimePool* = nullptr);
+  RSA(const std::string&, const unsigned = 0);   // load a key saved with saveKey
   ~RSA();
 
+  // write the key material to a file that the loading constructor reads back
+  void saveKey(const std::string&) const;
+
+  // select the block mode (TRIGRAPH_BLOCKS by default) and query the resulting block sizes
+  void setBlockMode(const BlockMode);
+  size_t plaintextBlockSize() const;    // # of bytes in plaintext blocks
+  size_t ciphertextBlockSize() const;   // # of chars in ciphertext blocks (base-52 digits of n - 1)
+
+  // select the format file encryption writes (TEXT_FORMAT by default)
+  void setFileFormat(const FileFormat);
+
+  // how prime candidates are tested during key generation. MILLER_RABIN: random-base rounds, as many
+  // as the candidate's size calls for. BAILLIE_PSW: a base-2 strong probable-prime test followed by a
+  // strong lucas test. candidates below 3.3 * 10^24 always get a deterministic set of bases.
+  enum PrimalityTest { MILLER_RABIN, BAILLIE_PSW };
+  static void setPrimalityTest(const PrimalityTest);   // process-wide, MILLER_RABIN by default
+
   // encryption & decryption methods
   std::string encrypt(const std::string&);    // encrypt plaintext block
   std::string decrypt(const std::string&);    // decrypt ciphertext block
 
-  // encrypt & decrypt files
-  void file_encrypt(const std::string&, const std::string&);
-  void file_decrypt(const std::string&, const std::string&);
+  // batch variants: the blocks run their exponentiations MultiBufferMontgomery::LANES at a time, one
+  // block per SIMD lane, on CPUs with AVX-512 IFMA (one block at a time elsewhere). results keep the input order.
+  std::vector<std::string> encrypt_batch(const std::vector<std::string>&);
+  std::vector<std::string> decrypt_batch(const std::vector<std::string>&);
+
+  // encrypt & decrypt files. blocks are spread over a worker pool: 0 threads uses the
+  // pool of this RSA instance, any other count runs on a temporary pool of that size
+  void file_encrypt(const std::string&, const std::string&, const unsigned = 0);
+  void file_decrypt(const std::string&, const std::string&, const unsigned = 0);
+
+  // streaming variants: the file is read, transformed and written in fixed-size chunks by a
+  // read -> transform -> write pipeline, so memory is bounded by the chunk size, not the file size
+  void file_encrypt_stream(const std::string&, const std::string&, const size_t = STREAM_CHUNK_BYTES, const unsigned = 0);
+  void file_decrypt_stream(const std::string&, const std::string&, const size_t = STREAM_CHUNK_BYTES, const unsigned = 0);
+
+  // random access into a file produced by file_encrypt: only the requested blocks are read (memory-mapped)
+  // and decrypted. decrypt_range selects ciphertext blocks, decrypt_bytes selects a plaintext byte range.
+  std::string decrypt_range(const std::string&, const size_t, const size_t, const unsigned = 0);
+  std::string decrypt_bytes(const std::string&, const size_t, const size_t, const unsigned = 0);
+
+  // toggle chinese remainder theorem private-key operations (on by default)
+  void setCRT(const bool);
 
   // debugging function (output rsa variables)
   void debug();
 
 private:
   // codebook used for enciphering & deciphering. defines mapping for chars to integers and vice-versa.
+  // the tables are built at compile time and shared by every RSA instance; unmapped chars hold -1.
   struct Codebook {
-    const char NULL_CHAR;               // what PLAINTEXT char is considered null
-    std::map<char, BigInt> char_num;    // character to number mapping
-    std::map<BigInt, char> num_char;    // number to character mapping
-    long unsigned int base;       // correlates to number of valid plaintext characters (char_num)
-    Codebook():
-      NULL_CHAR{ '-' },
-      char_num({
-        {'A', 0},  {'B', 1},  {'C', 2},  {'D', 3},  {'E', 4},
-        {'F', 5},  {'G', 6},  {'H', 7},  {'I', 8},  {'J', 9},
-        {'K', 10}, {'L', 11}, {'M', 12}, {'N', 13}, {'O', 14},
-        {'P', 15}, {'Q', 16}, {'R', 17}, {'S', 18}, {'T', 19},
-        {'U', 20}, {'V', 21}, {'W', 22}, {'X', 23}, {'Y', 24},
-        {'Z', 25}, {'a', 26}, {'b', 27}, {'c', 28}, {'d', 29},
-        {'e', 30}, {'f', 31}, {'g', 32}, {'h', 33}, {'i', 34},
-        {'j', 35}, {'k', 36}, {'l', 37}, {'m', 38}, {'n', 39},
-        {'o', 40}, {'p', 41}, {'q', 42}, {'r', 43}, {'s', 44},
-        {'t', 45}, {'u', 46}, {'v', 47}, {'w', 48}, {'x', 49},
-        {'y', 50}, {'z', 51}, {NULL_CHAR, 0}
-        }),
-      num_char({
-        {0,  'A'}, {1,  'B'}, {2,  'C'}, {3,  'D'}, {4,  'E'},
-        {5,  'F'}, {6,  'G'}, {7,  'H'}, {8,  'I'}, {9,  'J'},
-        {10, 'K'}, {11, 'L'}, {12, 'M'}, {13, 'N'}, {14, 'O'},
-        {15, 'P'}, {16, 'Q'}, {17, 'R'}, {18, 'S'}, {19, 'T'},
-        {20, 'U'}, {21, 'V'}, {22, 'W'}, {23, 'X'}, {24, 'Y'},
-        {25, 'Z'}, {26, 'a'}, {27, 'b'}, {28, 'c'}, {29, 'd'},
-        {30, 'e'}, {31, 'f'}, {32, 'g'}, {33, 'h'}, {34, 'i'},
-        {35, 'j'}, {36, 'k'}, {37, 'l'}, {38, 'm'}, {39, 'n'},
-        {40, 'o'}, {41, 'p'}, {42, 'q'}, {43, 'r'}, {44, 's'},
-        {45, 't'}, {46, 'u'}, {47, 'v'}, {48, 'w'}, {49, 'x'},
-        {50, 'y'}, {51, 'z'}
-        }),
-        base{ num_char.size() } {
-    }
-    bool check_char(std::map<char, BigInt> map, char key) { if (map.find(key) == map.end()) { return false; } else { return true; } };
-    bool check_num(std::map<BigInt, char> map, BigInt key) { if (map.find(key) == map.end()) { return false; } else { return true; } };
-    BigInt char_to_num(const char& c) { try { return char_num.at(c); } catch (std::exception& ex) { throw ("No key found"); } }
-    char num_to_char(const BigInt& x) { try { return num_char.at(x); } catch (std::exception& ex) { throw ("No key found"); } }
+    static constexpr char NULL_CHAR = '-';    // what PLAINTEXT char is considered null
+    static constexpr int base = 52;           // correlates to number of valid plaintext characters (num_char)
+    static constexpr int limb_digits = 11;    // base digits in one limb: base^11 < 2^64
+    static constexpr limb_t limb_power = 7516865509350965248ULL;   // base^limb_digits
+
+    // number to character mapping
+    static constexpr char num_char[base] = {
+      'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+      'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+      'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+      'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'
+    };
+
+    // character to number mapping for ciphertext: the 52 letters plus the null char (0)
+    static constexpr std::array<signed char, 256> cipher_num = buildCodebookTable(num_char, base, NULL_CHAR, false);
+    // character to number mapping for plaintext: letters are read case-insensitively (a == A == 0)
+    static constexpr std::array<signed char, 256> plain_num = buildCodebookTable(num_char, base, NULL_CHAR, true);
   };
-  Codebook codebook;    // codebook instance used for enciphering and deciphering
+  ThreadPool workers;   // worker pool used for key generation and file processing
 
   BigInt p, q;          // primes p and q
   BigInt n;             // modulo used with keys
   BigInt phi_n;         // euler totient
   BigInt e;             // public key
   BigInt d;             // private key
+  Montgomery mont_n;    // montgomery context for modulus n, shared by encryption and decryption
+
+  // chinese remainder theorem private-key data
+  bool use_crt;         // decrypt with dP/dQ/qInv instead of the full-size d
+  BigInt dP, dQ;        // d mod (p-1), d mod (q-1)
+  BigInt qInv;          // q^-1 mod p
+  Montgomery mont_p;    // montgomery context for modulus p
+  Montgomery mont_q;    // montgomery context for modulus q
+
+  // multi-buffer contexts for n, p and q, used by batches when the CPU supports them. each costs a
+  // reduction, so they are built on the first batch or file operation instead of with the key.
+  mutable std::once_flag multibuffer_once;
+  mutable MultiBufferMontgomery mb_n, mb_p, mb_q;
+
+  // block layout
+  BlockMode block_mode;       // how plaintext is packed into blocks
+  size_t byte_block_bytes;    // plaintext bytes per block in BYTE_BLOCKS mode: largest k with 256^k <= n
+  size_t cipher_block_chars;  // ciphertext chars per block: base-52 digits needed for n - 1
+  size_t residue_bytes;       // ciphertext bytes per block in a binary container: bytes needed for n
+  FileFormat file_format;     // format written by file encryption
+
+  // window recodings of the key exponents, computed once at key creation
+  SlidingWindowExponent e_windows, d_windows, dP_windows, dQ_windows;
 
   // Key retreival methods
   BigInt getPublicKey() const;
@@ -93,26 +226,70 @@ private:
   BigInt getPrivateKey() const;
 
   // RSA class initialization methods
-  BigInt generateRandomPrime(const int) const;                    // generate random prime number (used to get p and q)
-  BigInt randomBigInt(const int) const;                           // generate random number with n digits
-  BigInt randomBigIntInRange(const BigInt, const BigInt) const;   // generate random number within an upper and lower range
-  bool isPrimeMillerRabin(const BigInt, const int) const;         // check is a number is prime using miller-rabin method
-  bool MillerRabinTest(BigInt, const BigInt) const;               // perform miller rabin test on a number
+  void generatePrimePair(const int, PrimePool*);                  // take p and q from a pool or search for them concurrently
+  static BigInt generateRandomPrime(const int, const std::atomic<bool>* = nullptr, const bool = true); // generate random prime number (used to get p and q)
+  static const std::vector<int>& smallPrimes();                   // table of small odd primes for candidate sieving
+  static std::mutex& consoleMutex();                              // serializes progress output from worker threads
+  static BigInt randomBigInt(const int);                          // generate random number with n digits
+  static BigInt randomBigIntInRange(const BigInt, const BigInt);  // generate random number within an upper and lower range
+  static BigInt randomBigIntBelow(const BigInt&);                 // generate random number below a positive bound
+  static std::atomic<int>& primalityTest();                       // test selected by setPrimalityTest
+  static bool isProbablePrime(const BigInt&, const std::atomic<bool>* = nullptr); // size-calibrated primality test
+  static int millerRabinRounds(const int);                        // random-base rounds for a candidate of n bits
+  static bool isPrimeMillerRabin(const BigInt&, const int, const std::atomic<bool>* = nullptr); // check is a number is prime using miller-rabin method
+  static bool MillerRabinTest(const BigInt&, const SlidingWindowExponent&, const int, const Montgomery&, const BigInt&); // perform miller rabin test on a number
+  static bool strongLucasTest(const BigInt&, const std::atomic<bool>* = nullptr); // strong lucas probable-prime test (selfridge parameters)
+  static int jacobi(long long, const BigInt&);                    // jacobi symbol (a / n) for odd n > 0
+  static bool isPerfectSquare(const BigInt&);                     // true if n = r^2 for an integer r
 
   // utility methods
-  BigInt pow(const BigInt&, int) const;                           // simple pow() method that can accept a BigInt base
-  BigInt fastModExpBigInt(BigInt, BigInt, BigInt) const;          // fast mod-exp algorithm: computes a^b mod (n)
-  BigInt euclidsExtended(BigInt, BigInt) const;                   // euclidean algorithm, used to find private key
+  static BigInt pow(const BigInt&, int);                          // simple pow() method that can accept a BigInt base
+  static BigInt fastModExpBigInt(const BigInt&, const BigInt&, const BigInt&); // fast mod-exp algorithm: computes a^b mod (n)
+  static BigInt fastModExpBigInt(const BigInt&, const BigInt&, const Montgomery&); // mod-exp with a prebuilt montgomery context
+  static BigInt fastModExpBigInt(const BigInt&, const SlidingWindowExponent&, const Montgomery&); // mod-exp with a cached exponent recoding
+  BigInt privateExp(const BigInt&) const;                         // computes c^d mod n, with CRT when enabled
+  BigInt recombineCRT(const BigInt&, const BigInt&) const;        // garner recombination of c^dP mod p and c^dQ mod q
+  ThreadPool& selectPool(const unsigned, std::unique_ptr<ThreadPool>&); // pool for a file operation with a given thread count
+  std::vector<std::string> processBlocks(const std::vector<std::string>&, const bool, const bool, ThreadPool&); // encrypt/decrypt blocks in parallel
+  void transformBlocks(const std::vector<std::string>&, std::vector<std::string>&, const size_t, const size_t, const bool, const bool) const; // encrypt/decrypt a range of blocks in SIMD lane groups
+  std::string decryptBlockRange(const std::string&, const size_t, const size_t, const unsigned, const bool); // decrypt_range core
+  void streamBlocks(const std::string&, const std::string&, const bool, size_t, const unsigned); // chunked file pipeline
+
+  // block packing helpers
+  BigInt packBlock(const std::string&) const;           // plaintext block -> message integer
+  std::string unpackBlock(const BigInt&) const;         // message integer -> plaintext block
+  std::string encryptBlock(const std::string&, const bool) const; // plaintext block -> text or binary ciphertext block
+  std::string decryptBlock(const std::string&, const bool) const; // text or binary ciphertext block -> plaintext block
+  BigInt readCiphertextBlock(const std::string&, const bool) const; // text or binary ciphertext block -> checked residue
+  std::string encodeCiphertext(BigInt) const;           // residue -> base-52 ciphertext block
+  BigInt decodeCiphertext(const std::string&) const;    // base-52 ciphertext block -> residue
+  void padPlaintext(std::string&) const;                // pad a plaintext out to whole blocks
+  void unpadPlaintext(std::string&) const;              // strip the padding from a decrypted plaintext
+  bool skipsPlaintextByte(const char) const;            // true for bytes the block mode drops from plaintext
+
+  // binary ciphertext container helpers
+  std::string containerHeader(const uint64_t) const;                      // header for a container of n blocks
+  bool readContainerHeader(const char*, const size_t, uint64_t&) const;   // parse and validate a header
+  static void putBigEndian(char*, uint64_t, const int);                   // write an integer as big-endian bytes
+  static uint64_t getBigEndian(const char*, const int);                   // read big-endian bytes as an integer
+
+  // key file helpers
+  static void putKeyField(std::string&, const BigInt&);                   // append a length-prefixed integer
+  static void putKeyField(std::string&, const uint64_t);                  // append a fixed-width integer
+  static BigInt getKeyField(const char*, const size_t, size_t&);          // read a length-prefixed integer
+  static uint64_t getKeyWord(const char*, const size_t, size_t&);         // read a fixed-width integer
 };
 
 
 // ******************** Public methods ********************
 
 // info: Initializes the RSA class so that encryption and decryption can occur.
-// params: int specifying how many digits the primes used for the RSA scheme should be
+// params: int specifying how many digits the primes used for the RSA scheme should be,
+//         number of worker threads (0 picks the hardware concurrency), optional pool to take the primes from
 // returns: RSA class members are assigned values such that encryption and decryption can take place.
 inline
-RSA::RSA(const int decimal_digits_count) {
+RSA::RSA(const int decimal_digits_count, const unsigned threads, PrimePool* prime_pool):
+  workers(threads), use_crt(true), block_mode(TRIGRAPH_BLOCKS), file_format(TEXT_FORMAT) {
   std::cout << "Initializing RSA crypto-system..." << std::endl;
 
   // verify number of digits for primes p and q are valid
@@ -121,210 +298,682 @@ RSA::RSA(const int decimal_digits_count) {
 
   // calculate random primes p and q of length decimal_digits_count
   std::cout << "Initializing system primes..." << std::endl;
-  while (1) {
-    p = generateRandomPrime(decimal_digits_count);
-    q = generateRandomPrime(decimal_digits_count);
-    if (p != q)
-      break;
-  }
+  generatePrimePair(decimal_digits_count, prime_pool);
   std::cout << "System primes initialized." << std::endl;
 
   n = BigInt((p * q));                                // calculate modulus
   phi_n = BigInt((p - BigInt(1)) * (q - BigInt(1)));  // calcualte euler totient
+  mont_n = Montgomery(n);                             // reduction context reused by every encrypt/decrypt
+
+  // block sizes follow from the modulus: every message must stay below n, every residue must fit a ciphertext block
+  byte_block_bytes = (n.bitLength() - 1) / 8;
+  cipher_block_chars = 0;
+  for (BigInt x = n - BigInt(1); !x.isZero(); x /= Codebook::base)
+    cipher_block_chars++;
+  residue_bytes = (n.bitLength() + 7) / 8;
 
   std::cout << "Calculating system keys..." << std::endl;
-  for (BigInt i = 2; i < phi_n; i = i + 1) { // calculate public key e such that gcd(phi_n,e) = 1 for 1 < e < phi_n
-    if (gcd(i, phi_n) == 1) {
-      e = i;
-      break;
+  // public key e: the standard 65537 if gcd(e, phi_n) = 1 for 1 < e < phi_n, otherwise (tiny keys, or phi_n
+  // a multiple of 65537) the smallest odd e that qualifies
+  e = BigInt(PUBLIC_EXPONENT);
+  if (e >= phi_n || gcd(e, phi_n) != BigInt(1)) {
+    for (BigInt i = 3; i < phi_n; i += BigInt(2)) {
+      if (gcd(i, phi_n) == BigInt(1)) {
+        e = i;
+        break;
+      }
     }
   }
   if (e <= BigInt(1) || e >= phi_n)         // sanity check- this condition should never be true
     throw std::logic_error("Calculated euler totient is of incorrect value. Try again");
 
-  d = euclidsExtended(e, phi_n);           // calculate private key d
+  d = modInverse(e, phi_n);                // calculate private key d
   if (((e * d) % phi_n) != BigInt(1))      // another sanity check- this condition should never be true
     throw std::logic_error("Variables produced violate requirements for RSA. Try again");
 
+  // precompute the CRT exponents and the garner coefficient for decryption
+  dP = d % (p - BigInt(1));
+  dQ = d % (q - BigInt(1));
+  qInv = modInverse(q, p);
+  mont_p = Montgomery(p);
+  mont_q = Montgomery(q);
+
+  // recode the key exponents once so per-block exponentiations never re-scan them
+  e_windows = SlidingWindowExponent(e);
+  d_windows = SlidingWindowExponent(d);
+  dP_windows = SlidingWindowExponent(dP);
+  dQ_windows = SlidingWindowExponent(dQ);
+
   std::cout << "System keys initialized." << std::endl;
   std::cout << "RSA crypto-system initialized." << std::endl;
 }
 
 
+// info: Initializes the RSA class from a key file written by saveKey. the file is memory-mapped and every
+//       key value, montgomery context and block size is read back as stored, so no prime search or
+//       modular arithmetic runs at startup.
+// params: key filename, number of worker threads (0 picks the hardware concurrency)
+// returns: RSA class members are assigned values such that encryption and decryption can take place.
+inline
+RSA::RSA(const std::string& fname_key, const unsigned threads):
+  workers(threads), use_crt(true), block_mode(TRIGRAPH_BLOCKS), file_format(TEXT_FORMAT) {
+  MappedFile file(fname_key);
+  const char* data = file.data();
+  const size_t size = file.size();
+  if (size < 8 || memcmp(data, "\x89RSK", 4) != 0) {
+    throw std::logic_error("Not an RSA key file.");
+  }
+  if ((unsigned char)data[4] != KEY_FILE_VERSION) {
+    throw std::logic_error("Unsupported key file version.");
+  }
+
+  size_t pos = 8;
+  n = getKeyField(data, size, pos);
+  e = getKeyField(data, size, pos);
+  d = getKeyField(data, size, pos);
+  p = getKeyField(data, size, pos);
+  q = getKeyField(data, size, pos);
+  phi_n = getKeyField(data, size, pos);
+  dP = getKeyField(data, size, pos);
+  dQ = getKeyField(data, size, pos);
+  qInv = getKeyField(data, size, pos);
+
+  Montgomery* contexts[3] = { &mont_n, &mont_p, &mont_q };
+  const BigInt* moduli[3] = { &n, &p, &q };
+  for (int i = 0; i < 3; i++) {
+    limb_t n0inv = getKeyWord(data, size, pos);
+    BigInt R2 = getKeyField(data, size, pos);
+    BigInt one = getKeyField(data, size, pos);
+    *contexts[i] = Montgomery(*moduli[i], n0inv, R2, one);
+  }
+
+  byte_block_bytes = getKeyWord(data, size, pos);
+  cipher_block_chars = getKeyWord(data, size, pos);
+  residue_bytes = getKeyWord(data, size, pos);
+  if (pos != size) {
+    throw std::logic_error("Key file has trailing data.");
+  }
+
+  // the block sizes must be the ones n implies, or packed messages could reach n and come back wrong.
+  // byte and residue sizes are bit counts. the bit length of n - 1 leaves at most two candidates for its
+  // base-52 digit count; a comparison with one power of 52 picks the right one, without dividing n.
+  const int bits = n.bitLength();
+  const double log2_base = 5.700439718141092;   // log2(52)
+  size_t expected_chars = (size_t)((bits - 1) / log2_base) + 1;
+  if (bits >= 2 && expected_chars != (size_t)(bits / log2_base) + 1
+      && n - BigInt(1) >= pow(BigInt(Codebook::base), (int)expected_chars))
+    expected_chars++;
+  if (bits < 2 || byte_block_bytes != (size_t)(bits - 1) / 8 || residue_bytes != (size_t)(bits + 7) / 8
+      || cipher_block_chars != expected_chars) {
+    throw std::logic_error("Key file block sizes do not match the key modulus.");
+  }
+
+  // the window recodings are a single scan over each exponent's bits
+  e_windows = SlidingWindowExponent(e);
+  d_windows = SlidingWindowExponent(d);
+  dP_windows = SlidingWindowExponent(dP);
+  dQ_windows = SlidingWindowExponent(dQ);
+
+  std::cout << "RSA crypto-system loaded." << std::endl;
+}
+
 inline
 RSA::~RSA() {}
 
+// info: saves the key so a later process can load it with RSA(fname_key) instead of generating a new one.
+//       layout, integers big-endian: magic "\x89RSK", version byte, 3 reserved bytes, then n, e, d, p, q,
+//       phi_n, dP, dQ, qInv as (4-byte length, bytes) fields, then -N^-1 mod 2^64 (8 bytes), R^2 and R
+//       for each montgomery context (n, p, q), then the plaintext/ciphertext/residue block sizes (8 bytes each).
+// params: key filename. the file holds the private key: it is written to a temporary file in the same
+//         directory that is created with mode 0600, then renamed over the target, so no other user ever
+//         sees the key and a failed save leaves any previous key file intact.
+inline
+void RSA::saveKey(const std::string& fname_key) const {
+  std::string contents("\x89RSK\0\0\0\0", 8);
+  contents[4] = (char)KEY_FILE_VERSION;
+
+  const BigInt* values[9] = { &n, &e, &d, &p, &q, &phi_n, &dP, &dQ, &qInv };
+  for (int i = 0; i < 9; i++) {
+    putKeyField(contents, *values[i]);
+  }
+  const Montgomery* contexts[3] = { &mont_n, &mont_p, &mont_q };
+  for (int i = 0; i < 3; i++) {
+    putKeyField(contents, (uint64_t)contexts[i]->n0inv);
+    putKeyField(contents, contexts[i]->R2);
+    putKeyField(contents, contexts[i]->one);
+  }
+  putKeyField(contents, (uint64_t)byte_block_bytes);
+  putKeyField(contents, (uint64_t)cipher_block_chars);
+  putKeyField(contents, (uint64_t)residue_bytes);
+
+  std::string fname_tmp = fname_key + ".XXXXXX";
+  int fd = ::mkostemp(&fname_tmp[0], O_CLOEXEC);   // O_CREAT | O_EXCL, mode 0600
+  if (fd < 0) {
+    throw std::range_error("Key file could not be opened.");
+  }
+  bool written = ::fchmod(fd, S_IRUSR | S_IWUSR) == 0;   // 0600 regardless of how mkostemp was built
+  for (size_t done = 0; written && done < contents.size(); ) {
+    ssize_t count = ::write(fd, contents.data() + done, contents.size() - done);
+    if (count < 0 && errno == EINTR)
+      continue;
+    written = count > 0;
+    done += written ? (size_t)count : 0;
+  }
+  written = written && ::fsync(fd) == 0;
+  written = ::close(fd) == 0 && written;
+  written = written && std::rename(fname_tmp.c_str(), fname_key.c_str()) == 0;
+  std::fill(contents.begin(), contents.end(), '\0');
+  if (!written) {
+    ::unlink(fname_tmp.c_str());
+    throw std::runtime_error("Key file could not be written.");
+  }
+}
+
+// info: selects how plaintext is packed into blocks. BYTE_BLOCKS carries (bits(n) - 1) / 8 arbitrary
+//       bytes per block, so one exponentiation covers far more plaintext than a 3-letter trigraph.
+inline
+void RSA::setBlockMode(const BlockMode mode) {
+  block_mode = mode;
+}
+
+// info: returns the # of bytes in a plaintext block for the current block mode
+inline
+size_t RSA::plaintextBlockSize() const {
+  return block_mode == BYTE_BLOCKS ? byte_block_bytes : BLOCK_SIZE_PLAINTEXT_BYTES;
+}
+
+// info: returns the # of chars in a ciphertext block, enough base-52 digits for any residue mod n
+inline
+size_t RSA::ciphertextBlockSize() const {
+  return cipher_block_chars;
+}
+
+// info: selects the format file_encrypt and file_encrypt_stream write. BINARY_FORMAT stores each residue
+//       in (bits(n) + 7) / 8 bytes instead of ciphertextBlockSize() letters and decodes with a copy
+//       instead of a multiply-add per letter. every decrypt method accepts both formats.
+inline
+void RSA::setFileFormat(const FileFormat format) {
+  file_format = format;
+}
+
+// info: selects how decrypt performs the private-key operation. with CRT on, c^d mod n is computed
+//       as two half-size exponentiations mod p and mod q; with it off the full-size d and n are used.
+inline
+void RSA::setCRT(const bool enabled) {
+  use_crt = enabled;
+}
+
 // info: takes a string that is the filename containing plaintext and another string
 ///      that is a filename to output the encrypted plaintext to.
+// params: input and output filenames, number of worker threads (0 uses this instance's pool)
 inline
-void RSA::file_encrypt(const std::string& fname_in, const std::string& fname_out) {
+void RSA::file_encrypt(const std::string& fname_in, const std::string& fname_out, const unsigned threads) {
   // if file cannot be found
-  std::ifstream ifile(fname_in);
+  std::ifstream ifile(fname_in, std::ios::binary);
   if (!ifile) {
     throw std::range_error("Input file could not be opened.");
   }
 
   // read file contents
-  std::string line, plaintext;
-  while (std::getline(ifile, line)) {
-    plaintext += line;
+  std::string plaintext;
+  for (std::istreambuf_iterator<char> it(ifile), end; it != end; ++it) {
+    if (!skipsPlaintextByte(*it)) {
+      plaintext += *it;
+    }
   }
   ifile.close();
 
   // if file cannot be found
-  std::ofstream ofile(fname_out);
+  std::ofstream ofile(fname_out, std::ios::binary);
   if (!ofile) {
     throw std::range_error("Output file could not be opened.");
   }
 
-  // start encrypting plaintext block by block
-  std::string ciphertext = "";
-  std::string::const_iterator iter = plaintext.begin();
-  while (iter != plaintext.end()) {
-    std::string plaintext_block;
-    for (int i = 0; i < BLOCK_SIZE_PLAINTEXT_BYTES; i++) {
-      if (iter == plaintext.end()) {
-        break;
-      }
-      plaintext_block += *iter;
-      iter++;
-    }
-    // if plaintext is not big enough, pad it to fit
-    if (plaintext_block.size() < BLOCK_SIZE_PLAINTEXT_BYTES) {
-      int diff = BLOCK_SIZE_PLAINTEXT_BYTES - plaintext_block.size();
-      std::string temp = "";
-      for (int i = 0; i < diff; i++) {
-        temp += "-"; // padding character
-      }
-      temp += plaintext_block;
-      plaintext_block = temp;
-    }
-    std::string ciphertext_block = encrypt(plaintext_block); // encrypt the block
-    ciphertext += ciphertext_block;
+  // pad plaintext to whole blocks and split it into blocks
+  padPlaintext(plaintext);
+  const size_t block_size = plaintextBlockSize();
+  std::vector<std::string> plaintext_blocks;
+  for (size_t i = 0; i < plaintext.size(); i += block_size) {
+    plaintext_blocks.push_back(plaintext.substr(i, block_size));
+  }
+
+  // encrypt the blocks in parallel, then output them in their original order
+  const bool binary = file_format == BINARY_FORMAT;
+  std::unique_ptr<ThreadPool> own_pool;
+  std::vector<std::string> ciphertext_blocks = processBlocks(plaintext_blocks, true, binary, selectPool(threads, own_pool));
+  if (binary) {
+    ofile << containerHeader(ciphertext_blocks.size());
+  }
+  for (size_t i = 0; i < ciphertext_blocks.size(); i++) {
+    ofile << ciphertext_blocks[i];
   }
-  ofile << ciphertext; // output the ciphertext block to the file
 
   ofile.close();
 }
 
 // info: takes a string that is a filename containing encrypted data (fname_int) (file produced by file_encrypt function)
 //       and outputs the decrypted file contents to fname_out.
+// params: input and output filenames, number of worker threads (0 uses this instance's pool)
 inline
-void RSA::file_decrypt(const std::string& fname_in, const std::string& fname_out) {
+void RSA::file_decrypt(const std::string& fname_in, const std::string& fname_out, const unsigned threads) {
   // if file cannot be found
-  std::ifstream ifile(fname_in);
+  std::ifstream ifile(fname_in, std::ios::binary);
   if (!ifile) {
     throw std::range_error("Input file could not be opened.");
   }
 
   // read ciphertext file contents
-  std::string line;
-  std::string ciphertext;
-  while (std::getline(ifile, line)) {
-    ciphertext += line;
-  }
+  std::string contents((std::istreambuf_iterator<char>(ifile)), std::istreambuf_iterator<char>());
   ifile.close();
 
   // if file cannot be found
-  std::ofstream ofile(fname_out);
+  std::ofstream ofile(fname_out, std::ios::binary);
   if (!ofile) {
     throw std::range_error("Output file could not be opened.");
   }
 
-  // start decrypted ciphertext block by block
-  std::string plaintext = "";
-  std::string::const_iterator iter = ciphertext.begin();
-  while (iter != ciphertext.end()) {
-    std::string ciphertext_block;
-    for (int i = 0; i < BLOCK_SIZE_CIPHERTEXT_BYTES; i++) {
-      if (iter == plaintext.end()) {
-        break;
+  // split ciphertext into blocks: fixed-width residues after a container header, otherwise base-52 text
+  // in which line breaks are not part of any ciphertext block
+  std::vector<std::string> ciphertext_blocks;
+  uint64_t block_count;
+  const bool binary = readContainerHeader(contents.data(), contents.size(), block_count);
+  if (binary) {
+    if (contents.size() != CONTAINER_HEADER_BYTES + block_count * residue_bytes) {
+      throw std::logic_error("Ciphertext container is truncated.");
+    }
+    for (size_t i = CONTAINER_HEADER_BYTES; i < contents.size(); i += residue_bytes) {
+      ciphertext_blocks.push_back(contents.substr(i, residue_bytes));
+    }
+  }
+  else {
+    std::string ciphertext;
+    for (size_t i = 0; i < contents.size(); i++) {
+      if (contents[i] != '\n' && contents[i] != '\r') {
+        ciphertext += contents[i];
       }
-      ciphertext_block += *iter;
-      iter++;
     }
+
     // sanity check- if somehow the ciphertext is not of proper block size.
-    while (ciphertext_block.size() < BLOCK_SIZE_CIPHERTEXT_BYTES || ciphertext_block.size() > BLOCK_SIZE_CIPHERTEXT_BYTES ) {
+    const size_t block_size = ciphertextBlockSize();
+    if (ciphertext.size() % block_size != 0) {
       throw std::logic_error("Ciphertext block of invalid size");
     }
-    std::string plaintext_block = decrypt(ciphertext_block); // decrypt the ciphertext block
-    plaintext += plaintext_block;
+    for (size_t i = 0; i < ciphertext.size(); i += block_size) {
+      ciphertext_blocks.push_back(ciphertext.substr(i, block_size));
+    }
+  }
+
+  // decrypt the blocks in parallel, then output them in their original order
+  std::unique_ptr<ThreadPool> own_pool;
+  std::vector<std::string> plaintext_blocks = processBlocks(ciphertext_blocks, false, binary, selectPool(threads, own_pool));
+  std::string plaintext;
+  for (size_t i = 0; i < plaintext_blocks.size(); i++) {
+    plaintext += plaintext_blocks[i];
+  }
+  if (!plaintext.empty()) {
+    unpadPlaintext(plaintext);
   }
   ofile << plaintext; // output decrypted ciphertext
 
   ofile.close();
 }
 
-// info: takes a two-byte (2-chars) plaintext string and 
-//       returns a BLOCK_SIZE_CIPHERTEXT_BYTES length encrypted string
+// info: streaming counterpart of file_encrypt. plaintext is read in chunks of chunk_bytes (rounded to whole
+//       blocks) while earlier chunks are being encrypted and written. in TRIGRAPH_BLOCKS mode line breaks
+//       are skipped, as in file_encrypt, since the codebook has no code for them.
+// params: input and output filenames, input bytes per chunk, number of worker threads (0 uses this instance's pool)
 inline
-std::string RSA::encrypt(const std::string& block) {
-  Codebook* cbook_ptr;
-  cbook_ptr = &codebook;
+void RSA::file_encrypt_stream(const std::string& fname_in, const std::string& fname_out, const size_t chunk_bytes, const unsigned threads) {
+  streamBlocks(fname_in, fname_out, true, chunk_bytes, threads);
+}
 
-  if (block.size() < BLOCK_SIZE_PLAINTEXT_BYTES || block.size() > BLOCK_SIZE_PLAINTEXT_BYTES) {
-    throw std::range_error("Plainext block is of incorrect size.");
-  }
+// info: streaming counterpart of file_decrypt, reads ciphertext in chunks of chunk_bytes (rounded to whole blocks)
+//       from either file format
+// params: input and output filenames, input bytes per chunk, number of worker threads (0 uses this instance's pool)
+inline
+void RSA::file_decrypt_stream(const std::string& fname_in, const std::string& fname_out, const size_t chunk_bytes, const unsigned threads) {
+  streamBlocks(fname_in, fname_out, false, chunk_bytes, threads);
+}
 
-  BigInt trigraph = 0;
+// info: three-stage pipeline behind the streaming file methods. a reader thread fills chunks, the calling
+//       thread encrypts/decrypts them on the worker pool and a writer thread writes the results. the stages
+//       hand chunks over through queues of STREAM_QUEUE_DEPTH entries, so reading and writing overlap the
+//       arithmetic (double buffering) and at most a handful of chunks are held in memory at once. a binary
+//       container is written with a zero block count that is patched once the last block is out.
+// params: input and output filenames, true to encrypt (false to decrypt), input bytes per chunk,
+//         number of worker threads (0 uses this instance's pool)
+inline
+void RSA::streamBlocks(const std::string& fname_in, const std::string& fname_out, const bool encrypting, size_t chunk_bytes, const unsigned threads) {
+  // if file cannot be found
+  std::ifstream ifile(fname_in, std::ios::binary);
+  if (!ifile) {
+    throw std::range_error("Input file could not be opened.");
+  }
+  std::ofstream ofile(fname_out, std::ios::binary);
+  if (!ofile) {
+    throw std::range_error("Output file could not be opened.");
+  }
 
-  // construct the trigraph
-  for (long unsigned int i = 0; i < block.size(); i++) {
-    if (!cbook_ptr->check_char(cbook_ptr->char_num, toupper(char(block[i])))) {
-      throw std::range_error("Unreadable plaintext character detected. Ensure plaintext consists of ONLY LETTERS.");
+  // the container header decides the ciphertext layout: written up front when encrypting, detected when decrypting
+  bool binary = encrypting && file_format == BINARY_FORMAT;
+  uint64_t expected_blocks = 0, block_count = 0;
+  if (binary) {
+    ofile << containerHeader(0);
+  }
+  else if (!encrypting) {
+    char header[CONTAINER_HEADER_BYTES];
+    ifile.read(header, CONTAINER_HEADER_BYTES);
+    binary = readContainerHeader(header, ifile.gcount(), expected_blocks);
+    if (!binary) {
+      ifile.clear();
+      ifile.seekg(0);
     }
-    trigraph += pow(cbook_ptr->base, (block.size() - 1) - i) * cbook_ptr->char_to_num(toupper((char(block[i]))));
   }
 
-  // calculate enciphered trigraph (RSA encryption)
-  BigInt ciphertext = fastModExpBigInt(trigraph, e, n);
-
-  // construct quadragraph from enciphered trigraph
-  std::string quadragraph = "";
-  for (long unsigned int i = 0; i < BLOCK_SIZE_CIPHERTEXT_BYTES - 2; i++) {
-    BigInt index = ciphertext / pow(cbook_ptr->base,(BLOCK_SIZE_CIPHERTEXT_BYTES-1)-i);
-    quadragraph += (cbook_ptr->num_to_char(index));
-    ciphertext = ciphertext % pow(cbook_ptr->base,(BLOCK_SIZE_CIPHERTEXT_BYTES-1)-i);
+  const size_t block_size = encrypting ? plaintextBlockSize() : (binary ? residue_bytes : ciphertextBlockSize());
+  chunk_bytes = std::max(block_size, chunk_bytes / block_size * block_size);
+
+  std::unique_ptr<ThreadPool> own_pool;
+  ThreadPool& pool = selectPool(threads, own_pool);
+  BoundedQueue<std::string> read_queue(STREAM_QUEUE_DEPTH);
+  BoundedQueue<std::string> write_queue(STREAM_QUEUE_DEPTH);
+  std::exception_ptr read_error, transform_error, write_error;
+
+  // read stage: whole chunks of chunk_bytes, bytes outside the block alphabet dropped. the last chunk
+  // is padded to whole blocks when encrypting
+  std::thread reader([&]() {
+    try {
+      std::vector<char> buffer(chunk_bytes);
+      std::string chunk;
+      chunk.reserve(chunk_bytes);
+      while (ifile.read(buffer.data(), buffer.size()) || ifile.gcount() > 0) {
+        for (std::streamsize i = 0; i < ifile.gcount(); i++) {
+          if (encrypting ? skipsPlaintextByte(buffer[i]) : (!binary && (buffer[i] == '\n' || buffer[i] == '\r')))
+            continue;
+          chunk += buffer[i];
+          if (chunk.size() == chunk_bytes) {
+            if (!read_queue.push(std::move(chunk)))
+              return;
+            chunk = std::string();
+            chunk.reserve(chunk_bytes);
+          }
+        }
+      }
+      if (encrypting)
+        padPlaintext(chunk);
+      if (!chunk.empty())
+        read_queue.push(std::move(chunk));
+    }
+    catch (...) {
+      read_error = std::current_exception();
+    }
+    read_queue.close();
+  });
+
+  // write stage
+  std::thread writer([&]() {
+    try {
+      std::string chunk;
+      while (write_queue.pop(chunk)) {
+        ofile.write(chunk.data(), chunk.size());
+        if (!ofile)
+          throw std::runtime_error("Output file could not be written.");
+      }
+    }
+    catch (...) {
+      write_error = std::current_exception();
+    }
+    write_queue.close();   // makes the transform stage stop early on a write error
+    read_queue.close();
+  });
+
+  // transform stage. decrypted output is held back by one chunk, so padding can be stripped from the last one
+  try {
+    std::string chunk, held;
+    bool holding = false, complete = true;
+    while (read_queue.pop(chunk)) {
+      // sanity check- if somehow the ciphertext is not of proper block size.
+      if (chunk.size() % block_size != 0) {
+        throw std::logic_error("Ciphertext block of invalid size");
+      }
+      std::vector<std::string> blocks;
+      for (size_t i = 0; i < chunk.size(); i += block_size)
+        blocks.push_back(chunk.substr(i, block_size));
+
+      block_count += blocks.size();
+
+      std::vector<std::string> results = processBlocks(blocks, encrypting, binary, pool);
+      std::string out;
+      for (size_t i = 0; i < results.size(); i++)
+        out += results[i];
+      if (holding && !write_queue.push(std::move(held))) {
+        complete = false;
+        break;
+      }
+      held = std::move(out);
+      holding = true;
+    }
+    if (complete && binary && !encrypting && block_count != expected_blocks) {
+      throw std::logic_error("Ciphertext container is truncated.");
+    }
+    if (holding && complete) {
+      if (!encrypting)
+        unpadPlaintext(held);
+      write_queue.push(std::move(held));
+    }
+  }
+  catch (...) {
+    transform_error = std::current_exception();
   }
-  quadragraph += cbook_ptr->num_to_char((ciphertext / cbook_ptr->base));
-  quadragraph += cbook_ptr->num_to_char((ciphertext % cbook_ptr->base));
+  read_queue.close();
+  write_queue.close();
+  reader.join();
+  writer.join();
+
+  if (transform_error)
+    std::rethrow_exception(transform_error);
+  if (read_error)
+    std::rethrow_exception(read_error);
+  if (write_error)
+    std::rethrow_exception(write_error);
+
+  if (binary && encrypting) {
+    char count[8];
+    putBigEndian(count, block_count, 8);
+    ofile.seekp(CONTAINER_HEADER_BYTES - 8);
+    ofile.write(count, 8);
+    if (!ofile)
+      throw std::runtime_error("Output file could not be written.");
+  }
+}
 
-  return quadragraph; // return the ciphertext
+// info: decrypts count blocks starting at block first_block of a file produced by file_encrypt.
+//       ciphertext blocks are fixed-width in both file formats, so block i starts at a computed file offset;
+//       the file is memory-mapped and only the pages holding the requested blocks are touched. a range that
+//       ends at the last block has its padding stripped.
+// params: ciphertext filename, index of the first block, number of blocks (clamped to the end of the file),
+//         number of worker threads (0 uses this instance's pool)
+// returns: plaintext of the selected blocks
+inline
+std::string RSA::decrypt_range(const std::string& fname_in, const size_t first_block, const size_t count, const unsigned threads) {
+  return decryptBlockRange(fname_in, first_block, count, threads, false);
 }
 
-// info: takes a returned by the encrypt function and decrypts it
+// info: decrypt_range, with a choice for a first block past the end of the file
+// params: as decrypt_range, then true to return "" for a first block past the end instead of throwing
 inline
-std::string RSA::decrypt(const std::string& block) {
-  Codebook* cbook_ptr;
-  cbook_ptr = &codebook;
+std::string RSA::decryptBlockRange(const std::string& fname_in, const size_t first_block, const size_t count,
+                                   const unsigned threads, const bool past_end_empty) {
+  MappedFile file(fname_in);
+  file.adviseRandom();
+  uint64_t container_blocks;
+  const bool binary = readContainerHeader(file.data(), file.size(), container_blocks);
+  const size_t block_size = binary ? residue_bytes : ciphertextBlockSize();
+  const size_t data_offset = binary ? CONTAINER_HEADER_BYTES : 0;
+  if (binary ? file.size() != data_offset + container_blocks * block_size : file.size() % block_size != 0) {
+    throw std::logic_error("Ciphertext block of invalid size");
+  }
 
-  // construct the enciphered trigraph
-  BigInt ciphertext(0);
-  for (long unsigned int i = 0; i < block.size(); i++) {
-    ciphertext += BigInt(cbook_ptr->char_to_num(char(block[i]))) * pow(cbook_ptr->base, (BLOCK_SIZE_CIPHERTEXT_BYTES - 1 - i));
+  const size_t total_blocks = (file.size() - data_offset) / block_size;
+  if (first_block > total_blocks) {
+    if (past_end_empty) {
+      return "";
+    }
+    throw std::range_error("Ciphertext block index out of range.");
   }
+  const size_t last_block = first_block + std::min(count, total_blocks - first_block);
 
-  // decrypt enciphered trigraph to reveal trigraph (RSA decryption)
-  BigInt trigraph = fastModExpBigInt(ciphertext, d, n);
+  std::vector<std::string> ciphertext_blocks;
+  for (size_t i = first_block; i < last_block; i++) {
+    ciphertext_blocks.push_back(std::string(file.data() + data_offset + i * block_size, block_size));
+  }
 
-  // convert the trigraph to plaintext
-  BigInt num_0 = trigraph / pow(cbook_ptr->base, 2);
-  BigInt num_1 = (trigraph % pow(cbook_ptr->base,2)) / cbook_ptr->base;
-  BigInt num_2 = (trigraph % pow(cbook_ptr->base,2)) % cbook_ptr->base;
+  std::unique_ptr<ThreadPool> own_pool;
+  std::vector<std::string> plaintext_blocks = processBlocks(ciphertext_blocks, false, binary, selectPool(threads, own_pool));
+  std::string plaintext;
+  for (size_t i = 0; i < plaintext_blocks.size(); i++) {
+    plaintext += plaintext_blocks[i];
+  }
+  if (last_block == total_blocks && last_block > first_block) {
+    unpadPlaintext(plaintext);
+  }
+  return plaintext;
+}
 
-  BigInt nums[BLOCK_SIZE_PLAINTEXT_BYTES] = { num_0, num_1, num_2 };
-  char codes[BLOCK_SIZE_PLAINTEXT_BYTES];
+// info: decrypts the plaintext bytes [offset, offset + length) of a file produced by file_encrypt by
+//       decrypting only the blocks that cover them
+// params: ciphertext filename, plaintext byte offset, number of plaintext bytes,
+//         number of worker threads (0 uses this instance's pool)
+// returns: the selected plaintext bytes (shorter if the range runs past the end of the file)
+inline
+std::string RSA::decrypt_bytes(const std::string& fname_in, const size_t offset, const size_t length, const unsigned threads) {
+  if (length == 0) {
+    return "";
+  }
+  const size_t block_size = plaintextBlockSize();
+  const size_t first_block = offset / block_size;
+  const size_t last_block = (offset + length - 1) / block_size;
+  std::string plaintext = decryptBlockRange(fname_in, first_block, last_block - first_block + 1, threads, true);
+  return plaintext.substr(std::min(plaintext.size(), offset - first_block * block_size), length);
+}
 
-  for (int i = 0; i < BLOCK_SIZE_PLAINTEXT_BYTES; i++) {
-    codes[i] = cbook_ptr->num_to_char(nums[i]);
+// info: picks the pool a file operation runs on
+// params: requested thread count (0 or the size of this instance's pool selects that pool),
+//         holder that owns a temporary pool of the requested size otherwise
+inline
+ThreadPool& RSA::selectPool(const unsigned threads, std::unique_ptr<ThreadPool>& own_pool) {
+  if (threads == 0 || threads == workers.size())
+    return workers;
+  own_pool.reset(new ThreadPool(threads));
+  return *own_pool;
+}
+
+// info: encrypts or decrypts a sequence of blocks. the sequence is cut into chunks that are
+//       spread over a work-stealing pool, and each result lands in its block's slot so the output
+//       keeps the input order.
+// params: blocks to transform, true to encrypt (false to decrypt), true for binary ciphertext blocks, pool to run on
+// returns: transformed blocks in input order
+inline
+std::vector<std::string> RSA::processBlocks(const std::vector<std::string>& blocks, const bool encrypting, const bool binary, ThreadPool& pool) {
+  // several chunks per worker, so stealing can even out uneven progress. chunks are whole lane groups,
+  // so only the last one can leave SIMD lanes idle.
+  const size_t lanes = MultiBufferMontgomery::LANES;
+  size_t chunk_size = std::max<size_t>(1, blocks.size() / (8 * pool.size()));
+  chunk_size = (chunk_size + lanes - 1) / lanes * lanes;
+  std::vector<std::string> results(blocks.size());
+  pool.parallelFor(blocks.size(), chunk_size, [&](size_t first, size_t last) {
+    transformBlocks(blocks, results, first, last, encrypting, binary);
+  });
+  return results;
+}
+
+// info: encrypts or decrypts blocks [first, last) on the calling thread. with multi-buffer contexts the
+//       blocks go through in groups of LANES that share every squaring and multiply; decryption with CRT
+//       runs the mod p and mod q halves as two lane groups and recombines each block afterwards.
+// params: blocks to transform, result slots (same size), block range, true to encrypt, true for binary ciphertext blocks
+inline
+void RSA::transformBlocks(const std::vector<std::string>& blocks, std::vector<std::string>& results, const size_t first,
+                          const size_t last, const bool encrypting, const bool binary) const {
+  std::call_once(multibuffer_once, [this] {
+    mb_n = MultiBufferMontgomery(n);
+    mb_p = MultiBufferMontgomery(p);
+    mb_q = MultiBufferMontgomery(q);
+  });
+  const bool lanes = encrypting || !use_crt ? mb_n.usable() : mb_p.usable() && mb_q.usable();
+  if (!lanes) {
+    for (size_t i = first; i < last; i++) {
+      LimbArena arena;   // every BigInt of the block lives and dies in here, only the string escapes
+      results[i] = encrypting ? encryptBlock(blocks[i], binary) : decryptBlock(blocks[i], binary);
+    }
+    return;
   }
 
-  std::string plaintext_string = "";
-  for (int i = 0; i < BLOCK_SIZE_PLAINTEXT_BYTES; i++) {
-    plaintext_string += codes[i];
+  const size_t group = MultiBufferMontgomery::LANES;
+  for (size_t i = first; i < last; i += group) {
+    LimbArena arena;   // every BigInt of the group lives and dies in here, only the strings escape
+    const size_t count = std::min(group, last - i);
+    BigInt in[group], out[group];
+    if (encrypting) {
+      for (size_t l = 0; l < count; l++) {
+        if (blocks[i + l].size() != plaintextBlockSize()) {
+          throw std::range_error("Plainext block is of incorrect size.");
+        }
+        in[l] = packBlock(blocks[i + l]);
+      }
+      mb_n.pow(out, in, count, e_windows);   // RSA encryption
+      for (size_t l = 0; l < count; l++)
+        results[i + l] = binary ? out[l].toBytes(residue_bytes) : encodeCiphertext(out[l]);
+      continue;
+    }
+
+    for (size_t l = 0; l < count; l++)
+      in[l] = readCiphertextBlock(blocks[i + l], binary);
+    if (use_crt) {   // RSA decryption
+      BigInt m1[group], m2[group];
+      for (size_t l = 0; l < count; l++)
+        m1[l] = in[l] % p;
+      mb_p.pow(m1, m1, count, dP_windows);
+      for (size_t l = 0; l < count; l++)
+        m2[l] = in[l] % q;
+      mb_q.pow(m2, m2, count, dQ_windows);
+      for (size_t l = 0; l < count; l++)
+        out[l] = recombineCRT(m1[l], m2[l]);
+    }
+    else
+      mb_n.pow(out, in, count, d_windows);
+    for (size_t l = 0; l < count; l++)
+      results[i + l] = unpackBlock(out[l]);
   }
+}
 
-  return plaintext_string; // return the plaintext
+// info: takes a plaintextBlockSize() length plaintext block and
+//       returns a ciphertextBlockSize() length encrypted string
+inline
+std::string RSA::encrypt(const std::string& block) {
+  return encryptBlock(block, false);
+}
+
+// info: takes a returned by the encrypt function and decrypts it
+inline
+std::string RSA::decrypt(const std::string& block) {
+  return decryptBlock(block, false);
+}
+
+// info: encrypts a sequence of plaintextBlockSize() length blocks on the calling thread
+// returns: ciphertextBlockSize() length encrypted strings, same as encrypt() on each block
+inline
+std::vector<std::string> RSA::encrypt_batch(const std::vector<std::string>& blocks) {
+  std::vector<std::string> results(blocks.size());
+  transformBlocks(blocks, results, 0, blocks.size(), true, false);
+  return results;
+}
+
+// info: decrypts a sequence of blocks returned by encrypt or encrypt_batch on the calling thread
+inline
+std::vector<std::string> RSA::decrypt_batch(const std::vector<std::string>& blocks) {
+  std::vector<std::string> results(blocks.size());
+  transformBlocks(blocks, results, 0, blocks.size(), false, false);
+  return results;
 }
 
 // ****************************************
@@ -352,60 +1001,244 @@ BigInt RSA::getKeyModulo() const {
 
 // --------------- Class initialization methods ---------------
 
-// info: Get an n-digit random prime number that has been verified via the miller-rabin method.
-// params: int specifying how many digits prime should be
-// returns: a random n-digit miller-rabin prime of BigInt type
+// info: finds two distinct n-digit primes and stores them in p and q. primes are taken from the prime pool
+//       first, if one is given. whatever is still missing is searched for: every pool worker runs its own
+//       randomized search, so p and q are searched concurrently and several candidates are tested
+//       at once. the first two distinct primes found win and the remaining searches are cancelled.
+// params: int specifying how many digits the primes should be, prime pool (may be null)
 inline
-BigInt RSA::generateRandomPrime(const int decimal_digits_count) const {
-  std::random_device rd;      // generate seed for random number generator (rng)
-  std::mt19937_64 rng(rd());  // random number generator
+void RSA::generatePrimePair(const int decimal_digits_count, PrimePool* prime_pool) {
+  std::mutex found_mutex;
+  std::vector<BigInt> found;
+  BigInt pooled;
+  while (prime_pool && found.size() < 2 && prime_pool->take(decimal_digits_count, pooled)) {
+    if (found.empty() || found[0] != pooled)
+      found.push_back(pooled);
+  }
+  std::atomic<bool> done(found.size() == 2);
+
+  std::vector<std::future<void> > searches;
+  for (unsigned w = 0; w < workers.size() && !done; w++) {
+    searches.push_back(workers.submit([&]() {
+      try {
+        while (!done) {
+          BigInt prime = generateRandomPrime(decimal_digits_count, &done);
+          if (prime.isZero())   // cancelled
+            return;
+          std::lock_guard<std::mutex> lock(found_mutex);
+          if (found.size() < 2 && (found.empty() || found[0] != prime))
+            found.push_back(prime);
+          if (found.size() == 2)
+            done = true;
+        }
+      }
+      catch (...) {
+        done = true;
+        throw;
+      }
+    }));
+  }
 
-  // used to generate a seq. of uniformly distributed random digits between 0-9
-  std::uniform_int_distribution<int> dist(0, 9);
+  // every search references this frame, so wait for all of them before rethrowing any error
+  for (size_t i = 0; i < searches.size(); i++)
+    searches[i].wait();
+  for (size_t i = 0; i < searches.size(); i++)
+    searches[i].get();
 
-  // create a "decimal_digits"-digits random number
-  std::string rand_num = "1";
-  for (int i = 0; i < decimal_digits_count - 2; i++) {
-    std::string rand_digit = std::to_string(dist(rng)); // get 1-digit rand between 0-9
-    rand_num += rand_digit;                             // append to random_number
-  }
-  rand_num += "1";
+  p = found[0];
+  q = found[1];
+}
 
-  // use miller-rabin to determine if rand_num is prime
-  std::cout << "Looking for primes..." << std::endl;
+// info: Get an n-digit random prime number that has been verified via isProbablePrime.
+//       candidates are start, start+2, start+4, ... from one random odd start. each window of
+//       SIEVE_WINDOW candidates is sieved against the small prime table using residues of the
+//       window start that are stepped forward incrementally, so only survivors reach miller-rabin.
+// params: int specifying how many digits prime should be, optional flag that cancels the search,
+//         whether to report progress on std::cout
+// returns: a random n-digit probable prime of BigInt type, or 0 if the search was cancelled
+inline
+BigInt RSA::generateRandomPrime(const int decimal_digits_count, const std::atomic<bool>* cancel, const bool verbose) {
+  const std::vector<int>& primes = smallPrimes();
+  const BigInt upper = pow(BigInt(10), decimal_digits_count);   // candidates must stay below 10^digits
+  const BigInt lower = pow(BigInt(10), decimal_digits_count - 1);
+
+  // only sieve with primes below every candidate, so a small prime is never rejected as its own factor
+  size_t sieve_count = 0;
+  while (sieve_count < primes.size() && BigInt(primes[sieve_count]) < lower)
+    sieve_count++;
+
+  if (verbose) {
+    std::lock_guard<std::mutex> lock(consoleMutex());
+    std::cout << "Looking for primes..." << std::endl;
+  }
   int counter = 0;
-  const int reset_interval = 200; // when counter == reset_interval, stop shuffling and make new prime candidate
-  const int max_evals = 5000;     // max number of prime candidates to check
-  const int rounds = 40;          // number of rounds for miller-rabin algorithm
-  while (!isPrimeMillerRabin(BigInt(rand_num), rounds)) { // while prime candidate is not prime by miller-rabin method
-    counter++;
-    std::cout << "Prime candidates evaluated: " << counter;
-    if (counter % reset_interval == 0) {        // if we have checked another 200 prime candidates
-      if (counter == max_evals) {               // if we have evaluated too many potential primes, throw exception
-        throw std::runtime_error("Timeout on prime number generation. Please try again.");
+  while (1) {
+    // create a "decimal_digits"-digits random odd starting point (upper - 1 is odd, so it stays below upper)
+    BigInt window_start = lower + randomBigIntBelow(upper - lower);
+    if (window_start.isEven())
+      window_start += BigInt(1);
+    std::vector<int> residues(sieve_count);
+    for (size_t i = 0; i < sieve_count; i++)
+      residues[i] = window_start % primes[i];
+
+    std::vector<char> composite(SIEVE_WINDOW);
+    while (window_start < upper) {
+      // offset j is window_start + 2j; it is divisible by p when j = -r * 2^-1 (mod p)
+      std::fill(composite.begin(), composite.end(), 0);
+      for (size_t i = 0; i < sieve_count; i++) {
+        long long p = primes[i];
+        long long j = (p - residues[i]) % p * ((p + 1) / 2) % p;
+        for (; j < SIEVE_WINDOW; j += p)
+          composite[j] = 1;
       }
-      else {                                    // create a completely new prime candidate
-        for (int i = 1; i < decimal_digits_count - 1; i++) {
-          std::string rand_digit = std::to_string(dist(rng)); // get 1-digit rand between 0-9
-          rand_num[i] = rand_digit[0];
+
+      for (int j = 0; j < SIEVE_WINDOW; j++) {
+        if (cancel && *cancel)
+          return BigInt();
+        if (composite[j])
+          continue;
+        BigInt candidate = window_start + BigInt(2LL * j);
+        if (candidate >= upper)
+          break;
+        counter++;
+        if (verbose) {
+          std::lock_guard<std::mutex> lock(consoleMutex());
+          std::cout << "Prime candidates evaluated: " << counter << "\r" << std::flush;
+        }
+        if (isProbablePrime(candidate, cancel)) {
+          if (verbose) {
+            std::lock_guard<std::mutex> lock(consoleMutex());
+            std::cout << std::endl << "Prime acquired." << std::endl;
+          }
+          return candidate;
         }
       }
+
+      // step every residue to the next window instead of recomputing them from the BigInt
+      window_start += BigInt(2LL * SIEVE_WINDOW);
+      for (size_t i = 0; i < sieve_count; i++)
+        residues[i] = (int)((residues[i] + 2LL * SIEVE_WINDOW) % primes[i]);
+    }
+    // ran past the largest n-digit number without a prime: restart from a fresh random point
+  }
+}
+
+// info: odd primes used to sieve prime candidates, built once on first use
+// returns: the first SMALL_PRIME_COUNT odd primes in increasing order
+inline
+const std::vector<int>& RSA::smallPrimes() {
+  static const std::vector<int> primes = [] {
+    const int limit = 20000;   // comfortably holds the first SMALL_PRIME_COUNT primes
+    std::vector<char> sieve(limit, 1);
+    std::vector<int> res;
+    for (int i = 3; i < limit && (int)res.size() < SMALL_PRIME_COUNT; i += 2) {
+      if (!sieve[i])
+        continue;
+      res.push_back(i);
+      for (long long k = (long long)i * i; k < limit; k += 2 * i)
+        sieve[k] = 0;
     }
-    else {                                      // if we have not checked another 200 prime candidates
-      // shuffle every digit of the prime candidate, except first and last digit
-      std::shuffle(rand_num.begin() + 1, rand_num.end() - 1, rng);
+    return res;
+  }();
+  return primes;
+}
+
+// info: lock held while worker threads write progress to std::cout
+inline
+std::mutex& RSA::consoleMutex() {
+  static std::mutex console;
+  return console;
+}
+
+// info: primality test used for key generation. small factors are trial divided out first. numbers
+//       below 3317044064679887385961981 (about 2^81) take miller-rabin with the first 13 primes as bases,
+//       which no composite that small passes. larger ones take the test chosen by setPrimalityTest.
+// params: prime candidate BigInt and an optional flag that stops the test (a cancelled test reports false)
+inline
+bool RSA::isProbablePrime(const BigInt& num, const std::atomic<bool>* cancel) {
+  if (num <= BigInt(1)) {
+    return false;
+  }
+  const std::vector<int>& primes = smallPrimes();
+  if (num.isEven()) {
+    return num == BigInt(2);
+  }
+  for (int i = 0; i < TRIAL_DIVISION_PRIMES; i++) {
+    if (num == BigInt(primes[i])) {
+      return true;
+    }
+    if (num % primes[i] == 0) {
+      return false;
     }
-    std::cout << "\r";
   }
-  std::cout << std::endl << "Prime acquired." << std::endl;
 
-  return BigInt(rand_num);
+  static const BigInt deterministic_limit("3317044064679887385961981");
+  if (num < deterministic_limit) {
+    // num is odd with no factor up to primes[TRIAL_DIVISION_PRIMES - 1] > 41, so every base is below num
+    BigInt d = num - BigInt(1);
+    const int s = d.lowestSetBit();
+    const SlidingWindowExponent d_windows(d >> s);
+    Montgomery mont(num);
+    const BigInt minus_one = num - mont.one;
+    for (int base : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41 }) {
+      if (!MillerRabinTest(BigInt(base), d_windows, s, mont, minus_one)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (primalityTest() == BAILLIE_PSW) {
+    // miller-rabin with base 2 (two is never drawn by chance, so run it here), then lucas
+    BigInt d = num - BigInt(1);
+    const int s = d.lowestSetBit();
+    Montgomery mont(num);
+    if (!MillerRabinTest(BigInt(2), SlidingWindowExponent(d >> s), s, mont, num - mont.one)) {
+      return false;
+    }
+    return strongLucasTest(num, cancel);
+  }
+  return isPrimeMillerRabin(num, millerRabinRounds(num.bitLength()), cancel);
+}
+
+// info: miller-rabin rounds with random bases that keep the error below 2^-80 for a random odd candidate
+//       of the given size (damgard-landrock-pomerance, HAC table 4.4). 2^-80 is what 40 rounds guarantee
+//       for a worst-case input; a random candidate gets there with far fewer.
+// params: bit length of the candidate
+inline
+int RSA::millerRabinRounds(const int bits) {
+  if (bits >= 1300) return 2;
+  if (bits >= 850) return 3;
+  if (bits >= 650) return 4;
+  if (bits >= 550) return 5;
+  if (bits >= 450) return 6;
+  if (bits >= 400) return 7;
+  if (bits >= 350) return 8;
+  if (bits >= 300) return 9;
+  if (bits >= 250) return 12;
+  if (bits >= 200) return 15;
+  if (bits >= 150) return 18;
+  if (bits >= 100) return 27;
+  return 40;
+}
+
+// info: selects the test isProbablePrime runs on candidates above the deterministic range
+inline
+void RSA::setPrimalityTest(const PrimalityTest test) {
+  primalityTest() = test;
+}
+
+inline
+std::atomic<int>& RSA::primalityTest() {
+  static std::atomic<int> test(MILLER_RABIN);
+  return test;
 }
 
 // info: return true or false if BigInt n is prime based on miller-rabin test.
-// params: prime candidate BigInt and number of rounds for miller-rabin test.
+// params: prime candidate BigInt, number of rounds for miller-rabin test and an optional flag
+//         that stops the test between rounds (a cancelled test reports false).
 inline
-bool RSA::isPrimeMillerRabin(const BigInt num, const int rounds) const {
+bool RSA::isPrimeMillerRabin(const BigInt& num, const int rounds, const std::atomic<bool>* cancel) {
   if (num != BigInt(2) && num.isEven()) {
     return false;
   }
@@ -415,36 +1248,47 @@ bool RSA::isPrimeMillerRabin(const BigInt num, const int rounds) const {
   if (num < BigInt(4)) {
     return true;
   }
-  BigInt x = num - BigInt(1);
-  while (x.isEven()) {
-    x = x / BigInt(2);
-  }
+  // num - 1 = d * 2^s with d odd, factored once. every round reuses the window recoding of d and
+  // the montgomery form of num - 1.
+  BigInt d = num - BigInt(1);
+  const int s = d.lowestSetBit();
+  const SlidingWindowExponent d_windows(d >> s);
+  Montgomery mont(num);   // one reduction context shared by every round
+  const BigInt minus_one = num - mont.one;
+  const BigInt base_high = num - BigInt(2);
   for (int i = 0; i < rounds; i++) {
-    if (!MillerRabinTest(x, num)) {
+    if (cancel && *cancel) {
+      return false;
+    }
+    if (!MillerRabinTest(randomBigIntInRange(BigInt(2), base_high), d_windows, s, mont, minus_one)) {
       return false;
     }
   }
   return true;
 }
 
-// info: simple helper function for the isPrimeMRT method.
+// info: simple helper function for the isPrimeMRT method: one round with base a, where num - 1 = d * 2^s.
+//       a^d is left in montgomery form, so 1 and num-1 are compared in that form as well, and the
+//       squarings reuse z's storage.
+// params: base a, window recoding of d, s, context for num, num - 1 in montgomery form
 inline
-bool RSA::MillerRabinTest(BigInt x, const BigInt num) const {
-  BigInt a = randomBigIntInRange(BigInt(2), num - BigInt(1));
-  BigInt z = fastModExpBigInt(a, x, num);
+bool RSA::MillerRabinTest(const BigInt& a, const SlidingWindowExponent& d, const int s, const Montgomery& mont,
+                          const BigInt& minus_one) {
+  BigInt z = mont.powMont(a, d);
+  const BigInt& one = mont.one;
 
-  if (z == BigInt(1) || z == num - BigInt(1)) {
+  if (z == one || z == minus_one) {
     return true;
   }
 
-  while (x != num - BigInt(1)) {
-    z = (z * z) % num;
-    x = x * BigInt(2);
+  BigInt::limbs scratch;
+  for (int i = 1; i < s; i++) {
+    mont.mulInto(z, z, z, scratch);
 
-    if (z == BigInt(1)) {
+    if (z == one) {
       return false;
     }
-    if (z == num - BigInt(1)) {
+    if (z == minus_one) {
       return true;
     }
   }
@@ -452,42 +1296,199 @@ bool RSA::MillerRabinTest(BigInt x, const BigInt num) const {
   return false;
 }
 
+// info: strong lucas probable-prime test with selfridge's parameters: D is the first of 5, -7, 9, -11, ...
+//       with (D / n) = -1, P = 1 and Q = (1 - D) / 4. with n + 1 = d * 2^s, n passes if U_d = 0 or
+//       V_(d * 2^r) = 0 for some r < s. the sequences run in montgomery form, where multiplying by D and
+//       halving work as they do on plain residues.
+// params: odd candidate n > 41 without small factors, optional cancel flag (a cancelled test reports false)
+inline
+bool RSA::strongLucasTest(const BigInt& n, const std::atomic<bool>* cancel) {
+  long long D = 5;
+  for (int tries = 0; ; tries++) {
+    int j = jacobi(D, n);
+    if (j == -1) {
+      break;
+    }
+    if (j == 0) {   // D shares a factor with n, which is larger than |D|
+      return false;
+    }
+    if (tries == 8 && isPerfectSquare(n)) {   // no such D exists for a square
+      return false;
+    }
+    D = D > 0 ? -(D + 2) : -D + 2;
+  }
+  const long long Q = (1 - D) / 4;
+
+  Montgomery mont(n);
+  BigInt::limbs scratch;
+  auto reduce = [&n](BigInt& v) {
+    v %= n;
+    if (v.sign < 0) {
+      v += n;
+    }
+  };
+  auto half = [&n](BigInt& v) {   // v / 2 mod n
+    if (v.isOdd()) {
+      v += n;
+    }
+    v = v >> 1;
+  };
+  BigInt q_mont = BigInt(Q);
+  reduce(q_mont);
+  q_mont = mont.toMont(q_mont);
+
+  BigInt d = n + BigInt(1);
+  const int s = d.lowestSetBit();
+  d = d >> s;
+
+  // U_1 = 1, V_1 = P = 1, Q^1, then one doubling per bit of d and a step up for each set bit
+  BigInt U = mont.one, V = mont.one, Qk = q_mont, t;
+  for (int i = d.bitLength() - 2; i >= 0; i--) {
+    if (cancel && *cancel) {
+      return false;
+    }
+    mont.mulInto(U, U, V, scratch);        // U_2k = U_k V_k
+    mont.mulInto(V, V, V, scratch);        // V_2k = V_k^2 - 2 Q^k
+    V -= Qk;
+    V -= Qk;
+    reduce(V);
+    mont.mulInto(Qk, Qk, Qk, scratch);
+    if (d.testBit(i)) {
+      t = U * BigInt(D) + V;               // V_k+1 = (D U_k + P V_k) / 2
+      reduce(t);
+      U += V;                              // U_k+1 = (P U_k + V_k) / 2
+      reduce(U);
+      half(U);
+      half(t);
+      V = t;
+      mont.mulInto(Qk, Qk, q_mont, scratch);
+    }
+  }
+
+  if (U.isZero() || V.isZero()) {
+    return true;
+  }
+  for (int r = 1; r < s; r++) {
+    mont.mulInto(V, V, V, scratch);        // V_2k = V_k^2 - 2 Q^k
+    V -= Qk;
+    V -= Qk;
+    reduce(V);
+    if (V.isZero()) {
+      return true;
+    }
+    mont.mulInto(Qk, Qk, Qk, scratch);
+  }
+  return false;
+}
+
+// info: jacobi symbol (a / n) for an odd n > 0, by quadratic reciprocity. the first step reduces n
+//       modulo a, after which everything runs in machine words.
+// returns: -1, 0 or 1
+inline
+int RSA::jacobi(long long a, const BigInt& n) {
+  int res = 1;
+  if (a < 0) {   // (-1 / n) = -1 for n = 3 (mod 4)
+    a = -a;
+    if (n % 4 == 3) {
+      res = -res;
+    }
+  }
+  while (a != 0 && a % 2 == 0) {   // (2 / n) = -1 for n = 3, 5 (mod 8)
+    a /= 2;
+    int r = n % 8;
+    if (r == 3 || r == 5) {
+      res = -res;
+    }
+  }
+  if (a == 0) {
+    return n == BigInt(1) ? 1 : 0;
+  }
+  if (a % 4 == 3 && n % 4 == 3) {   // reciprocity: (a / n) = (n / a), negated when both are 3 mod 4
+    res = -res;
+  }
+  long long x = n % (int)a, y = a;
+  while (x != 0) {
+    while (x % 2 == 0) {
+      x /= 2;
+      if (y % 8 == 3 || y % 8 == 5) {
+        res = -res;
+      }
+    }
+    std::swap(x, y);
+    if (x % 4 == 3 && y % 4 == 3) {
+      res = -res;
+    }
+    x %= y;
+  }
+  return y == 1 ? res : 0;
+}
+
+// info: true if n is the square of an integer, by newton's integer square root
+inline
+bool RSA::isPerfectSquare(const BigInt& n) {
+  if (n.sign < 0) {
+    return false;
+  }
+  if (n.isZero()) {
+    return true;
+  }
+  BigInt x = BigInt(1) << ((n.bitLength() + 1) / 2);   // above the root
+  while (1) {
+    BigInt y = (x + n / x) >> 1;
+    if (y >= x) {
+      break;
+    }
+    x = y;
+  }
+  return x * x == n;
+}
+
 // info: return a random, n-digit number of BigInt type
 // params: number of digits the random number should have
 inline
-BigInt RSA::randomBigInt(const int digits_count) const {
+BigInt RSA::randomBigInt(const int digits_count) {
   if (digits_count <= 0) {
     throw std::invalid_argument("Invalid number of digits for random number to be generated.");
   }
 
-  std::stringstream ss;
-  std::random_device rd;
-
-  while (ss.tellp() < digits_count) { // while current random number is not enough digits in length
-    ss << rd();                       // add new random number to the current random number
-  }
-
-  // convert current random number to string, truncate digits if number has too many digits
-  std::string randomDigits = ss.str().substr(0, digits_count);
-  return BigInt(randomDigits);
+  const BigInt lower = pow(BigInt(10), digits_count - 1);
+  return lower + randomBigIntBelow(pow(BigInt(10), digits_count) - lower);
 }
 
 // info: return random number of BigInt type within specified range
 // params: range of potential random number: (low <= rand <= high)
 // returns: random number of big-int type whose value falls within low and high
 inline
-BigInt RSA::randomBigIntInRange(const BigInt low, const BigInt high) const {
+BigInt RSA::randomBigIntInRange(const BigInt low, const BigInt high) {
   if (low >= high) {
     throw std::invalid_argument("Invalid value range for random number to be generated.");
   }
 
-  BigInt diff = high - low;
-  std::stringstream s;
-  s << diff;
-  BigInt rand_diff_range = randomBigInt(s.str().length() + 1);
-  BigInt mod_r = rand_diff_range % diff;
-  BigInt rand_val = low + mod_r;
-  return rand_val;
+  return low + randomBigIntBelow(high - low + BigInt(1));
+}
+
+// info: return a uniformly random BigInt below bound. whole limbs come straight from the calling
+//       thread's ChaCha20 generator; the top limb is masked to the bit length of bound and draws at
+//       or above bound are redrawn, fewer than two draws on average.
+// params: positive upper bound (exclusive)
+inline
+BigInt RSA::randomBigIntBelow(const BigInt& bound) {
+  if (bound.sign < 0 || bound.isZero()) {
+    throw std::invalid_argument("Invalid bound for random number to be generated.");
+  }
+
+  ChaChaRng& rng = ChaChaRng::threadLocal();
+  const int top_bits = bound.bitLength() % limb_bits;
+  BigInt res;
+  do {
+    res.a.resize(bound.a.size());
+    rng.fill(res.a.data(), res.a.size());
+    if (top_bits)
+      res.a.back() &= ((limb_t)1 << top_bits) - 1;
+    res.sign = 1;
+    res.trim();
+  } while (res >= bound);
+  return res;
 }
 
 // ---------------------------------------------
@@ -499,22 +1500,345 @@ BigInt RSA::randomBigIntInRange(const BigInt low, const BigInt high) const {
 // params: BigInt's a, b and m
 // returns: (a^b) mod (m)
 inline
-BigInt RSA::fastModExpBigInt(BigInt a, BigInt b, BigInt m) const {
+BigInt RSA::fastModExpBigInt(const BigInt& a, const BigInt& b, const BigInt& m) {
+  if (Montgomery::applicable(m))
+    return fastModExpBigInt(a, b, Montgomery(m));
+
+  // even modulus: barrett reduction, so the loop needs no long division
+  const Barrett reducer(m);
   BigInt f(1);
-  a = a % m;
+  BigInt x = reducer.mod(a);
 
-  while (b > BigInt(0)) {     // Figure 9.8: for i = k until i = 0
-    if (b.isOdd())            // Figure 9.8:  if b_i = 1 
-      f = (f * a) % m;
-    a = (a * a) % m;
-    b = b / 2;                // Figure 9.8:  c <- 2 * c
+  for (int i = 0; i < b.bitLength(); i++) {   // Figure 9.8: for i = k until i = 0
+    if (b.testBit(i))                         // Figure 9.8:  if b_i = 1
+      reducer.mulInto(f, f, x);
+    reducer.mulInto(x, x, x);
   }
+  reducer.reduce(f);   // f = 1 is left unreduced when b = 0
 
   return f;
 }
 
+// info: fast modular exponentiation against a montgomery context built once for its modulus
+// params: BigInt's a and b, context for modulus m
+// returns: (a^b) mod (m)
+inline
+BigInt RSA::fastModExpBigInt(const BigInt& a, const BigInt& b, const Montgomery& mont) {
+  return mont.pow(a, b);
+}
+
+// info: fast modular exponentiation for an exponent whose window recoding is cached on the key
+// params: BigInt a, recoded exponent b, context for modulus m
+// returns: (a^b) mod (m)
+inline
+BigInt RSA::fastModExpBigInt(const BigInt& a, const SlidingWindowExponent& b, const Montgomery& mont) {
+  return mont.pow(a, b);
+}
+
+// --------------- Block packing methods ---------------
+
+// info: turns a plaintext block into the message integer that is exponentiated
+// params: plaintext block of plaintextBlockSize() bytes
+// returns: TRIGRAPH_BLOCKS: the base-52 trigraph value. BYTE_BLOCKS: the block read as a big-endian number
+inline
+BigInt RSA::packBlock(const std::string& block) const {
+  if (block_mode == BYTE_BLOCKS) {
+    return BigInt::fromBytes(block);
+  }
+
+  // construct the trigraph. invalid chars map to -1, so OR-ing every code flags them without branching
+  long long trigraph = 0;
+  int invalid = 0;
+  for (long unsigned int i = 0; i < block.size(); i++) {
+    int code = Codebook::plain_num[(unsigned char)block[i]];
+    invalid |= code;
+    trigraph = trigraph * Codebook::base + (code & 0xff);
+  }
+  if (invalid < 0) {
+    throw std::range_error("Unreadable plaintext character detected. Ensure plaintext consists of ONLY LETTERS.");
+  }
+  return BigInt(trigraph);
+}
+
+// info: inverse of packBlock
+inline
+std::string RSA::unpackBlock(const BigInt& message) const {
+  if (block_mode == BYTE_BLOCKS) {
+    if (message.bitLength() > 8 * (int)byte_block_bytes) {
+      throw std::range_error("Decrypted block does not fit in a plaintext block.");
+    }
+    return message.toBytes(byte_block_bytes);
+  }
+
+  const long long trigraph_count = (long long)Codebook::base * Codebook::base * Codebook::base;
+  if (message >= BigInt(trigraph_count)) {
+    throw std::range_error("Decrypted block is not a valid trigraph.");
+  }
+
+  // convert the trigraph to plaintext
+  long long t = message.longValue();
+  std::string plaintext_string(BLOCK_SIZE_PLAINTEXT_BYTES, Codebook::NULL_CHAR);
+  for (int i = BLOCK_SIZE_PLAINTEXT_BYTES - 1; i >= 0; i--) {
+    plaintext_string[i] = Codebook::num_char[t % Codebook::base];
+    t /= Codebook::base;
+  }
+  return plaintext_string;
+}
+
+// info: encrypts one plaintext block
+// params: plaintextBlockSize() length plaintext block, true for a binary (residue_bytes) ciphertext block
+//         instead of a base-52 one
+inline
+std::string RSA::encryptBlock(const std::string& block, const bool binary) const {
+  if (block.size() != plaintextBlockSize()) {
+    throw std::range_error("Plainext block is of incorrect size.");
+  }
+
+  BigInt message = packBlock(block);
+  BigInt ciphertext = fastModExpBigInt(message, e_windows, mont_n);   // RSA encryption
+  return binary ? ciphertext.toBytes(residue_bytes) : encodeCiphertext(ciphertext);
+}
+
+// info: decrypts one block produced by encryptBlock
+// params: ciphertext block, true if it is a binary (residue_bytes) block
+inline
+std::string RSA::decryptBlock(const std::string& block, const bool binary) const {
+  BigInt message = privateExp(readCiphertextBlock(block, binary));   // RSA decryption
+  return unpackBlock(message);
+}
+
+// info: reads one ciphertext block and checks that it is a residue mod n
+// params: ciphertext block, true if it is a binary (residue_bytes) block
+inline
+BigInt RSA::readCiphertextBlock(const std::string& block, const bool binary) const {
+  if (block.size() != (binary ? residue_bytes : ciphertextBlockSize())) {
+    throw std::range_error("Ciphertext block is of incorrect size.");
+  }
+
+  BigInt ciphertext = binary ? BigInt::fromBytes(block) : decodeCiphertext(block);
+  if (ciphertext >= n) {
+    throw std::range_error("Ciphertext block is not a residue of the key modulus.");
+  }
+  return ciphertext;
+}
+
+// info: writes a residue as ciphertextBlockSize() base-52 letters, least significant digit last
+inline
+std::string RSA::encodeCiphertext(BigInt ciphertext) const {
+  // one long division by base^limb_digits yields limb_digits letters, the rest is machine arithmetic
+  std::string quadragraph(ciphertextBlockSize(), Codebook::num_char[0]);
+  limb_t chunk = 0;
+  for (int i = (int)quadragraph.size() - 1; i >= 0 && !ciphertext.isZero(); ) {
+    chunk = BigInt::divAbsSmall(ciphertext.a, Codebook::limb_power);
+    for (int digit = 0; digit < Codebook::limb_digits && i >= 0; digit++, i--) {
+      quadragraph[i] = Codebook::num_char[chunk % Codebook::base];
+      chunk /= Codebook::base;
+    }
+  }
+  if (chunk || !ciphertext.isZero()) {
+    throw std::range_error("Ciphertext does not fit in a ciphertext block.");
+  }
+  return quadragraph;
+}
+
+// info: inverse of encodeCiphertext
+inline
+BigInt RSA::decodeCiphertext(const std::string& block) const {
+  BigInt ciphertext(0);
+  int invalid = 0;
+  for (long unsigned int i = 0; i < block.size(); i++) {
+    int code = Codebook::cipher_num[(unsigned char)block[i]];
+    invalid |= code;
+    ciphertext *= Codebook::base;
+    ciphertext += BigInt(code & 0xff);
+  }
+  if (invalid < 0) {
+    throw std::range_error("Unreadable ciphertext character detected.");
+  }
+  return ciphertext;
+}
+
+// info: pads a plaintext out to whole blocks. TRIGRAPH_BLOCKS: the last partial block gets NULL_CHARs in
+//       front. BYTE_BLOCKS: a 0x80 byte and then zero bytes are always appended (ISO/IEC 7816-4 style),
+//       so the exact length survives the round trip even for binary data.
+inline
+void RSA::padPlaintext(std::string& plaintext) const {
+  const size_t block_size = plaintextBlockSize();
+  if (block_mode == BYTE_BLOCKS) {
+    plaintext += '\x80';
+    plaintext.append((block_size - plaintext.size() % block_size) % block_size, '\0');
+    return;
+  }
+  size_t partial = plaintext.size() % block_size;
+  if (partial) {
+    plaintext.insert(plaintext.size() - partial, block_size - partial, Codebook::NULL_CHAR);
+  }
+}
+
+// info: strips BYTE_BLOCKS padding from the end of a fully decrypted plaintext (trigraph padding stays,
+//       as it always has)
+inline
+void RSA::unpadPlaintext(std::string& plaintext) const {
+  if (block_mode != BYTE_BLOCKS) {
+    return;
+  }
+  size_t end = plaintext.find_last_not_of('\0');
+  if (end == std::string::npos || plaintext[end] != '\x80') {
+    throw std::logic_error("Invalid block padding.");
+  }
+  plaintext.erase(end);
+}
+
+// info: TRIGRAPH_BLOCKS plaintext has no code for line breaks, so file methods drop them; BYTE_BLOCKS keeps every byte
+inline
+bool RSA::skipsPlaintextByte(const char c) const {
+  return block_mode == TRIGRAPH_BLOCKS && (c == '\n' || c == '\r');
+}
+
+// ---------------------------------------------
+
+
+// --------------- Binary container methods ---------------
+// header layout, integers big-endian:
+//   bytes  0-3   magic "\x89RSA" (the first byte is never a base-52 letter, so text ciphertext never matches)
+//   byte   4     container version
+//   byte   5     block mode the plaintext was packed with
+//   bytes  6-7   reserved, zero
+//   bytes  8-11  residue width in bytes (bytes needed for the modulus)
+//   bytes 12-15  plaintext bytes per block
+//   bytes 16-23  block count
+// the header is followed by block count residues of residue width bytes each.
+
+// info: builds the container header for this key and block mode
+// params: number of ciphertext blocks that follow the header
+inline
+std::string RSA::containerHeader(const uint64_t block_count) const {
+  std::string header(CONTAINER_HEADER_BYTES, '\0');
+  header.replace(0, 4, "\x89RSA");
+  header[4] = (char)CONTAINER_VERSION;
+  header[5] = (char)block_mode;
+  putBigEndian(&header[8], residue_bytes, 4);
+  putBigEndian(&header[12], plaintextBlockSize(), 4);
+  putBigEndian(&header[16], block_count, 8);
+  return header;
+}
+
+// info: checks whether data starts with a container header and, if so, that it matches this key
+// params: file bytes, their length, receives the block count
+// returns: false if data is not a binary container (e.g. text ciphertext), true if the header is valid
+inline
+bool RSA::readContainerHeader(const char* data, const size_t size, uint64_t& block_count) const {
+  if (size < 4 || memcmp(data, "\x89RSA", 4) != 0) {
+    return false;
+  }
+  if (size < CONTAINER_HEADER_BYTES) {
+    throw std::logic_error("Ciphertext container is truncated.");
+  }
+  if ((unsigned char)data[4] != CONTAINER_VERSION) {
+    throw std::logic_error("Unsupported ciphertext container version.");
+  }
+  if ((unsigned char)data[5] != block_mode || getBigEndian(data + 12, 4) != plaintextBlockSize()) {
+    throw std::logic_error("Ciphertext container was written with a different block mode.");
+  }
+  if (getBigEndian(data + 8, 4) != residue_bytes) {
+    throw std::logic_error("Ciphertext container was written for a different key size.");
+  }
+  block_count = getBigEndian(data + 16, 8);
+  return true;
+}
+
+inline
+void RSA::putBigEndian(char* out, uint64_t value, const int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    out[i] = (char)(value & 0xff);
+    value >>= 8;
+  }
+}
+
+inline
+uint64_t RSA::getBigEndian(const char* in, const int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value = (value << 8) | (unsigned char)in[i];
+  }
+  return value;
+}
+
+// ---------------------------------------------
+
+
+// --------------- Key file methods ---------------
+
+// info: appends a non-negative BigInt as a 4-byte big-endian length followed by its big-endian bytes
+inline
+void RSA::putKeyField(std::string& out, const BigInt& value) {
+  const size_t length = (value.bitLength() + 7) / 8;
+  char prefix[4];
+  putBigEndian(prefix, length, 4);
+  out.append(prefix, 4);
+  out += value.toBytes(length);
+}
+
+// info: appends an 8-byte big-endian integer
+inline
+void RSA::putKeyField(std::string& out, const uint64_t value) {
+  char word[8];
+  putBigEndian(word, value, 8);
+  out.append(word, 8);
+}
+
+// info: reads a field written by putKeyField(BigInt) at pos and advances pos past it
+inline
+BigInt RSA::getKeyField(const char* data, const size_t size, size_t& pos) {
+  if (size - pos < 4 || size - pos - 4 < getBigEndian(data + pos, 4)) {
+    throw std::logic_error("Key file is truncated.");
+  }
+  const size_t length = getBigEndian(data + pos, 4);
+  BigInt value = BigInt::fromBytes(data + pos + 4, length);
+  pos += 4 + length;
+  return value;
+}
+
+// info: reads a field written by putKeyField(uint64_t) at pos and advances pos past it
+inline
+uint64_t RSA::getKeyWord(const char* data, const size_t size, size_t& pos) {
+  if (size - pos < 8) {
+    throw std::logic_error("Key file is truncated.");
+  }
+  uint64_t value = getBigEndian(data + pos, 8);
+  pos += 8;
+  return value;
+}
+
+// ---------------------------------------------
+
+// info: RSA private-key operation
+// params: ciphertext residue c
+// returns: c^d mod n. with CRT enabled: m1 = c^dP mod p, m2 = c^dQ mod q, recombined with
+//          garner's formula m = m2 + q * (qInv * (m1 - m2) mod p)
+inline
+BigInt RSA::privateExp(const BigInt& c) const {
+  if (!use_crt)
+    return fastModExpBigInt(c, d_windows, mont_n);
+
+  BigInt m1 = fastModExpBigInt(c % p, dP_windows, mont_p);
+  BigInt m2 = fastModExpBigInt(c % q, dQ_windows, mont_q);
+  return recombineCRT(m1, m2);
+}
+
+// info: garner's recombination
+// params: m1 = c^dP mod p, m2 = c^dQ mod q
+// returns: m = m2 + q * (qInv * (m1 - m2) mod p), the residue mod n that agrees with both
+inline
+BigInt RSA::recombineCRT(const BigInt& m1, const BigInt& m2) const {
+  BigInt h = (qInv * (m1 - m2)) % p;
+  if (h < BigInt(0))
+    h += p;
+  return m2 + h * q;
+}
+
 inline
-BigInt RSA::pow(const BigInt& base, int exp) const {
+BigInt RSA::pow(const BigInt& base, int exp) {
   if (exp < 0) {
     if (base == 0)
       throw std::logic_error("Cannot divide by zero");
@@ -537,38 +1861,6 @@ BigInt RSA::pow(const BigInt& base, int exp) const {
   return result * result_odd;
 }
 
-// info: extended euclidean algorithm, used for computing private key
-inline
-BigInt RSA::euclidsExtended(BigInt E, BigInt eulerTotient) const {
-  BigInt a1 = 1, a2 = 0, b1 = 0, b2 = 1, d1 = eulerTotient, d2 = E, temp;
-
-  while (d2 != 1) {
-    BigInt k = (d1 / d2);
-
-    temp = a2;
-    a2 = a1 - (a2 * k);
-    a1 = temp;
-
-    temp = b2;
-    b2 = b1 - (b2 * k);
-    b1 = temp;
-
-    temp = d2;
-    d2 = d1 - (d2 * k);
-    d1 = temp;
-  }
-  BigInt x = b2;
-
-  if (x > eulerTotient) {
-    x = x % eulerTotient;
-  }
-  else if (x < 0) {
-    x = x + eulerTotient;
-  }
-
-  return x;
-}
-
 // ****************************************
 // ---------------------------------------------
 
@@ -588,7 +1880,123 @@ void RSA::debug() {
     << "'phi_n': " << phi_n << "," << std::endl
     << "'e': " << getPublicKey() << "," << std::endl
     << "'d': " << getPrivateKey() << "," << std::endl
+    << "'dP': " << dP << "," << std::endl
+    << "'dQ': " << dQ << "," << std::endl
+    << "'qInv': " << qInv << "," << std::endl
     << "}"
     << std::endl;
   std::cout << "***************************************" << std::endl;
 }
+
+
+// ******************** PrimePool methods ********************
+
+// info: creates one stock per digit size and starts the filler thread, which fills every stock up to
+//       the high watermark right away
+// params: digit sizes to stock, low and high watermarks (primes kept per size, low < high)
+inline
+PrimePool::PrimePool(const std::vector<int>& digit_sizes, const size_t low, const size_t high):
+  low_watermark(low), high_watermark(high), hit_count(0), miss_count(0), stopping(false) {
+  if (low >= high)
+    throw std::invalid_argument("Prime pool low watermark must be below its high watermark.");
+  for (size_t i = 0; i < digit_sizes.size(); i++) {
+    if (digit_sizes[i] < RSA::MIN_DIGITS || digit_sizes[i] > RSA::MAX_DIGITS)
+      throw std::invalid_argument("Invalid number of decimal digits for the prime pool.");
+    if (!find(digit_sizes[i]))
+      stocks.emplace_back(new Stock(digit_sizes[i], high));
+  }
+  filler = std::thread(&PrimePool::fill, this);
+}
+
+// info: cancels a search in progress and joins the filler thread
+inline
+PrimePool::~PrimePool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stopping = true;
+  }
+  wake_cv.notify_all();
+  filler.join();
+}
+
+// info: takes one prime of the given digit size. a take that leaves the stock at the low watermark, or
+//       finds it empty, wakes the filler thread.
+// params: digit size, receives the prime on a hit
+// returns: true on a hit, false if the stock is empty or the size is not stocked
+inline
+bool PrimePool::take(const int digits, BigInt& prime) {
+  Stock* stock = find(digits);
+  if (!stock) {
+    miss_count++;
+    return false;
+  }
+  bool hit = stock->primes.pop(prime);
+  if (hit)
+    hit_count++;
+  else
+    miss_count++;
+  if (stock->primes.size() <= low_watermark)
+    requestFill(*stock);
+  return hit;
+}
+
+inline
+size_t PrimePool::available(const int digits) const {
+  Stock* stock = find(digits);
+  return stock ? stock->primes.size() : 0;
+}
+
+inline
+PrimePool::Stock* PrimePool::find(const int digits) const {
+  for (size_t i = 0; i < stocks.size(); i++) {
+    if (stocks[i]->digits == digits)
+      return stocks[i].get();
+  }
+  return nullptr;
+}
+
+inline
+bool PrimePool::needsFill() const {
+  for (size_t i = 0; i < stocks.size(); i++) {
+    if (stocks[i]->refilling)
+      return true;
+  }
+  return false;
+}
+
+// info: marks a stock for refilling and wakes the filler thread if it was not already refilling it
+inline
+void PrimePool::requestFill(Stock& stock) {
+  if (stock.refilling.exchange(true))
+    return;
+  { std::lock_guard<std::mutex> lock(wake_mutex); }   // pairs with the wait predicate, no lost wakeups
+  wake_cv.notify_one();
+}
+
+// info: filler thread loop. searches one prime at a time for the emptiest stock that is refilling and
+//       sleeps while every stock is between its watermarks.
+inline
+void PrimePool::fill() {
+  while (!stopping) {
+    Stock* target = nullptr;
+    for (size_t i = 0; i < stocks.size(); i++) {
+      if (stocks[i]->refilling && (!target || stocks[i]->primes.size() < target->primes.size()))
+        target = stocks[i].get();
+    }
+    if (!target) {
+      std::unique_lock<std::mutex> lock(wake_mutex);
+      wake_cv.wait(lock, [this] { return stopping || needsFill(); });
+      continue;
+    }
+
+    BigInt prime = RSA::generateRandomPrime(target->digits, &stopping, false);
+    if (prime.isZero())   // cancelled
+      continue;
+    target->primes.push(prime);
+    if (target->primes.size() >= high_watermark) {
+      target->refilling = false;
+      if (target->primes.size() <= low_watermark)   // drained again while the flag was being cleared
+        requestFill(*target);
+    }
+  }
+}
@@ -0,0 +1,317 @@
+/* Work-stealing worker pool used by the RSA class */
+
+#ifndef THREADPOOL_CPP
+#define THREADPOOL_CPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+// info: a fixed set of worker threads, each with its own task deque. a worker takes its newest
+//       task first and, when its own deque is empty, steals the oldest task of another worker.
+//       tasks submitted from outside the pool are dealt round-robin over the deques.
+// params: number of worker threads, 0 picks the hardware concurrency.
+// note: tasks must not block waiting on other tasks of the same pool.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // number of worker threads
+  unsigned size() const { return (unsigned)workers.size(); }
+
+  // queue a task, the returned future yields its result or rethrows its exception
+  template <class F>
+  std::future<decltype(std::declval<F&>()())> submit(F task);
+
+  // run body(first, last) over [0, count) split into chunks of at most chunk_size, blocks until done
+  template <class F>
+  void parallelFor(size_t count, size_t chunk_size, F body);
+
+  // worker count used when 0 is requested
+  static unsigned defaultThreads();
+
+private:
+  struct TaskQueue {
+    std::deque<std::function<void()> > tasks;
+    std::mutex tasks_mutex;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<TaskQueue> > queues;   // one deque per worker
+  std::atomic<size_t> next_queue;                    // round-robin target for external submits
+  std::atomic<size_t> pending;                       // queued tasks not yet taken by a worker
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_cv;
+  bool stopping;
+
+  void push(std::function<void()>);
+  bool take(size_t, std::function<void()>&);
+  void run(size_t);
+
+  // pool and worker index of the calling thread (null / 0 outside any pool)
+  static ThreadPool*& currentPool() { static thread_local ThreadPool* pool = nullptr; return pool; }
+  static size_t& currentIndex() { static thread_local size_t index = 0; return index; }
+};
+
+
+inline
+ThreadPool::ThreadPool(unsigned threads):
+  next_queue(0), pending(0), stopping(false) {
+  if (threads == 0)
+    threads = defaultThreads();
+  for (unsigned i = 0; i < threads; i++)
+    queues.emplace_back(new TaskQueue());
+  for (unsigned i = 0; i < threads; i++)
+    workers.emplace_back(&ThreadPool::run, this, (size_t)i);
+}
+
+// info: lets the queued tasks finish, then joins every worker
+inline
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  sleep_cv.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+inline
+unsigned ThreadPool::defaultThreads() {
+  unsigned hw = std::thread::hardware_concurrency();
+  return hw ? hw : 1;
+}
+
+template <class F>
+std::future<decltype(std::declval<F&>()())> ThreadPool::submit(F task) {
+  typedef decltype(std::declval<F&>()()) result_type;
+  std::shared_ptr<std::packaged_task<result_type()> > packaged =
+    std::make_shared<std::packaged_task<result_type()> >(task);
+  std::future<result_type> result = packaged->get_future();
+  push([packaged]() { (*packaged)(); });
+  return result;
+}
+
+template <class F>
+void ThreadPool::parallelFor(size_t count, size_t chunk_size, F body) {
+  if (chunk_size == 0)
+    chunk_size = 1;
+  std::vector<std::future<void> > chunks;
+  for (size_t first = 0; first < count; first += chunk_size) {
+    size_t last = std::min(count, first + chunk_size);
+    chunks.push_back(submit([first, last, &body]() { body(first, last); }));
+  }
+  // every chunk references body, so wait for all of them before rethrowing any error
+  for (size_t i = 0; i < chunks.size(); i++)
+    chunks[i].wait();
+  for (size_t i = 0; i < chunks.size(); i++)
+    chunks[i].get();
+}
+
+// info: queues a task on the calling worker's own deque, or round-robin when called from outside
+inline
+void ThreadPool::push(std::function<void()> task) {
+  size_t target = currentPool() == this ? currentIndex() : next_queue++ % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);   // pairs with the wait predicate, no lost wakeups
+    pending++;                                       // counted first so take() never drives it below 0
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[target]->tasks_mutex);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  sleep_cv.notify_one();
+}
+
+// info: pops the newest task of worker self, otherwise steals the oldest task of another worker
+inline
+bool ThreadPool::take(size_t self, std::function<void()>& task) {
+  {
+    TaskQueue& own = *queues[self];
+    std::lock_guard<std::mutex> lock(own.tasks_mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      pending--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    TaskQueue& victim = *queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.tasks_mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      pending--;
+      return true;
+    }
+  }
+  return false;
+}
+
+// info: worker loop, runs tasks until the pool is stopping and every deque is drained
+inline
+void ThreadPool::run(size_t self) {
+  currentPool() = this;
+  currentIndex() = self;
+  while (1) {
+    std::function<void()> task;
+    if (take(self, task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    sleep_cv.wait(lock, [this] { return stopping || pending > 0; });
+    if (stopping && pending == 0)
+      return;
+  }
+}
+
+
+// info: fixed-capacity FIFO handing items between pipeline threads. push blocks while the queue
+//       is full and pop blocks while it is empty, which bounds the memory held between stages.
+//       close() wakes every waiter: later pushes fail and pops drain what is left, then fail.
+// params: maximum number of queued items
+template <class T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity):
+    capacity(capacity ? capacity : 1), closed(false) {
+  }
+
+  // returns false if the queue was closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(items_mutex);
+    not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed)
+      return false;
+    items.push_back(std::move(item));
+    not_empty.notify_one();
+    return true;
+  }
+
+  // returns false once the queue is closed and drained
+  bool pop(T& item) {
+    std::unique_lock<std::mutex> lock(items_mutex);
+    not_empty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty())
+      return false;
+    item = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(items_mutex);
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+private:
+  std::deque<T> items;
+  size_t capacity;
+  bool closed;
+  std::mutex items_mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+};
+
+
+// info: fixed-capacity multi-producer multi-consumer FIFO without locks (Vyukov's bounded queue).
+//       every cell carries a sequence number telling producers and consumers whose turn it is, so
+//       push and pop each cost one compare-and-swap on a position counter and never block: they
+//       fail instead when the queue is full or empty.
+// params: maximum number of queued items, rounded up to a power of two
+template <class T>
+class LockFreeQueue {
+public:
+  explicit LockFreeQueue(size_t capacity):
+    enqueue_pos(0), dequeue_pos(0) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  LockFreeQueue(const LockFreeQueue&) = delete;
+  LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+  // returns false if the queue is full
+  bool push(T item) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (1) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = std::move(item);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // returns false if the queue is empty
+  bool pop(T& item) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    while (1) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          item = std::move(cell.data);
+          cell.sequence.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // number of queued items, exact only while no push or pop is in flight
+  size_t size() const {
+    size_t head = dequeue_pos.load(std::memory_order_relaxed);
+    size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  alignas(64) std::atomic<size_t> enqueue_pos;   // producers and consumers on separate cache lines
+  alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+#endif
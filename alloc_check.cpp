@@ -0,0 +1,79 @@
+/* Allocation check for Montgomery exponentiation: run with make check */
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#include "RSA.cpp"
+
+// every global allocation in the process goes through these counters
+static std::atomic<size_t> allocations(0);
+
+static void* countedAlloc(size_t size, size_t align) {
+  allocations++;
+  void* p = align > alignof(std::max_align_t) ? std::aligned_alloc(align, (size + align - 1) / align * align)
+                                              : std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size) { return countedAlloc(size, 0); }
+void* operator new[](size_t size) { return countedAlloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// info: a value of exactly the given bit length, odd if requested
+static BigInt randomBits(int bits, bool odd) {
+  BigInt res;
+  res.a.resize((bits + 63) / 64);
+  ChaChaRng::threadLocal().fill(res.a.data(), res.a.size());
+  if (bits % 64)
+    res.a.back() &= ((limb_t)1 << (bits % 64)) - 1;
+  res.a.back() |= (limb_t)1 << ((bits - 1) % 64);
+  if (odd)
+    res.a[0] |= 1;
+  res.trim();
+  return res;
+}
+
+// info: allocations made by one Montgomery::pow call
+static size_t powAllocations(const Montgomery& mont, const BigInt& base, const SlidingWindowExponent& exp) {
+  size_t before = allocations.load();
+  BigInt res = mont.pow(base, exp);
+  return allocations.load() - before;
+}
+
+// info: the steady-state exponentiation loop must not allocate. setup (window table, scratch) does, but
+//       its cost depends only on the modulus and the window width, so two exponents of different lengths
+//       with the same window width must make the same number of allocations.
+int main() {
+  ChaChaRng::useSeed(1);
+  int failures = 0;
+  const int sizes[3] = { 8, 16, 31 };
+  for (int limbs : sizes) {
+    Montgomery mont(randomBits(64 * limbs, true));
+    BigInt base = randomBits(64 * limbs - 1, false);
+    SlidingWindowExponent short_exp(randomBits(720, true));   // both recode with 6-bit windows
+    SlidingWindowExponent long_exp(randomBits(2880, true));
+    powAllocations(mont, base, long_exp);   // warm-up: one-time kernel selection and thread-local scratch
+
+    size_t short_count = powAllocations(mont, base, short_exp);
+    size_t long_count = powAllocations(mont, base, long_exp);
+    std::cout << limbs << " limbs: " << short_count << " allocations for a 720-bit exponent, " << long_count
+              << " for a 2880-bit exponent" << std::endl;
+    if (short_count != long_count) {
+      std::cout << "FAIL: the exponentiation loop allocates" << std::endl;
+      failures++;
+    }
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+/* Correctness check for BigInt arithmetic: run with make check */
+
+#include <random>
+
+#include "BigInt.cpp"
+#include "Barrett.cpp"
+
+static std::mt19937_64 gen(415);
+static int failures = 0;
+
+// info: records a failed case
+static void expect(bool ok, const std::string& what) {
+  if (!ok) {
+    std::cout << "FAIL: " << what << std::endl;
+    failures++;
+  }
+}
+
+// info: a magnitude of exactly n limbs, random or all ones
+static BigInt operand(size_t n, bool ones = false) {
+  BigInt res;
+  res.a.resize(n);
+  for (size_t i = 0; i < n; i++)
+    res.a[i] = ones ? ~(limb_t)0 : gen();
+  if (n)
+    res.a[n - 1] |= (limb_t)1 << 63;
+  res.trim();
+  return res;
+}
+
+// info: reference product by the scalar schoolbook loop, independent of the multiplication ladder
+static BigInt schoolbook(const BigInt& x, const BigInt& y) {
+  BigInt res;
+  if (x.isZero() || y.isZero())
+    return res;
+  res.a.resize(x.a.size() + y.a.size());
+  scalarBasecaseMul(res.a.data(), x.a.data(), x.a.size(), y.a.data(), y.a.size());
+  res.sign = x.sign * y.sign;
+  res.trim();
+  return res;
+}
+
+// info: x * y and, for x == y, x.square() against the schoolbook reference
+static void checkProduct(const BigInt& x, const BigInt& y, const std::string& what) {
+  BigInt want = schoolbook(x, y);
+  expect(x * y == want && y * x == want, what);
+  if (&x == &y)
+    expect(x.square() == want, what + " (square)");
+}
+
+// every kernel this CPU runs against the scalar one, bit for bit: random and all-ones operands of every
+// length up to 24 limbs and a few that need slicing, each by a few shorter ones
+static void checkBasecaseKernels() {
+  std::vector<size_t> sizes;
+  for (size_t n = 1; n <= 24; n++)
+    sizes.push_back(n);
+  sizes.insert(sizes.end(), { BASECASE_SIMD_LIMBS, BASECASE_SIMD_LIMBS + 1, 2 * BASECASE_SIMD_LIMBS + 8 });
+  for (const BasecaseKernel& k : basecaseKernels()) {
+    for (size_t xn : sizes) {
+      for (size_t yn : { std::min(xn, BASECASE_SIMD_LIMBS + 1), (size_t)1, (size_t)3, (size_t)17 }) {
+        for (int ones = 0; ones < 2; ones++) {
+          BigInt x = operand(xn, ones), y = operand(yn, ones);
+          std::vector<limb_t> want(xn + yn), got(xn + yn);
+          scalarBasecaseMul(want.data(), x.a.data(), xn, y.a.data(), yn);
+          k.mul(got.data(), x.a.data(), xn, y.a.data(), yn);
+          expect(want == got, std::string(k.name) + " kernel on " + std::to_string(xn) + " by " + std::to_string(yn)
+                              + (ones ? " all-ones limbs" : " random limbs"));
+        }
+      }
+    }
+  }
+}
+
+// products at every crossover of mulThresholds(), one limb below, at and above it, for random and
+// all-ones operands: balanced, with a longer x (uneven halves) and unbalanced enough to be cut into slices.
+// the thresholds are read, not hard-coded, so the check follows a retune.
+static void checkMultiplication() {
+  const BigInt::MulThresholds& t = BigInt::mulThresholds();
+  const int crossovers[] = { t.simd_basecase, t.karatsuba, t.karatsuba_square, t.toom3, t.ntt };
+  for (int crossover : crossovers) {
+    if (crossover == t.ntt) {   // the reference is quadratic, so fewer shapes up there
+      BigInt below = operand(t.ntt - 1), x = operand(t.ntt), ones = operand(t.ntt, true);
+      checkProduct(below, operand(t.ntt - 1), std::to_string(t.ntt - 1) + "-limb product");
+      checkProduct(x, operand(t.ntt), std::to_string(t.ntt) + "-limb product");
+      checkProduct(ones, ones, std::to_string(t.ntt) + "-limb all-ones square");
+      checkProduct(operand(2 * t.ntt + 1), x, std::to_string(t.ntt) + "-limb random by a 2x longer operand");
+      continue;
+    }
+    for (size_t n = std::max(crossover, 2) - 1; n <= (size_t)crossover + 1; n++) {
+      for (int ones = 0; ones < 2; ones++) {
+        std::string size = std::to_string(n) + (ones ? "-limb all-ones" : "-limb random");
+        BigInt x = operand(n, ones), y = operand(n, ones);
+        checkProduct(x, y, size + " product");
+        checkProduct(x, x, size + " square");
+        checkProduct(operand(n + n / 2 + 1, ones), y, size + " by a 1.5x longer operand");
+        checkProduct(operand(2 * n + 1, ones), y, size + " by a 2x longer operand (slices)");
+        checkProduct(operand(5 * n + 3, ones), y, size + " by a 5x longer operand (slices)");
+      }
+    }
+  }
+  BigInt x = operand(t.karatsuba), y = -operand(3 * t.karatsuba);
+  checkProduct(x, y, "product with a negative factor");
+}
+
+// fixed decimal, hex and byte encodings of 3^300 and 7^5000, then round trips of random values across
+// DECIMAL_SPLIT_LIMBS, where decimal conversion turns divide-and-conquer
+static void checkConversions() {
+  BigInt p300(1), p5000(1);
+  for (int i = 0; i < 300; i++)
+    p300 *= 3;
+  for (int i = 0; i < 5000; i++)
+    p5000 *= 7;
+  const std::string dec300 = "136891479058588375991326027382088315966463695625337436471480190078368997177499076593800206"
+                             "155688941388250484440597994042813512732765695774566001";
+  const std::string hex300 = "b39cfff485a5dbf4d6aae030b91bfb0ec6bba389cd8d7f85bba3985c19c5e24e40c543a123c6e028a873e9e3"
+                             "874e1b4623a44be39b34e67dc5c2671";
+  expect(p300.toDecimal() == dec300 && BigInt(dec300) == p300, "3^300 in decimal");
+  expect(p300.toHex() == hex300 && BigInt::fromHex("0x" + hex300) == p300, "3^300 in hex");
+  expect((-p300).toDecimal() == "-" + dec300 && BigInt("-" + dec300) == -p300, "-3^300 in decimal");
+
+  std::string dec5000 = p5000.toDecimal(), hex5000 = p5000.toHex(), bytes5000 = p5000.toBytes();
+  expect(dec5000.size() == 4226 && p5000.digitCount() == 4226 && dec5000.compare(0, 30, "309171940135976921141730874494") == 0
+         && dec5000.compare(4196, 30, "695345718779025402256403000001") == 0, "7^5000 in decimal");
+  expect(hex5000.size() == 3510 && hex5000.compare(0, 30, "1b5f2430e919052d843455a3bbd845") == 0
+         && hex5000.compare(3480, 30, "3e48ecbb39f2964908ff3c4870eac1") == 0, "7^5000 in hex");
+  BigInt tail = BigInt::fromBytes(bytes5000.substr(bytes5000.size() - 8));
+  expect(bytes5000.size() == 1755 && (unsigned char)bytes5000[0] == 0x1b && tail.toHex() == "4908ff3c4870eac1",
+         "7^5000 in bytes");
+  expect(BigInt(dec5000) == p5000 && BigInt::fromHex(hex5000) == p5000, "7^5000 round trip");
+
+  for (size_t n = 1; n <= 3 * 32 + 2; n++) {
+    BigInt x = operand(n, n % 7 == 0);
+    std::string dec = x.toDecimal();
+    expect(BigInt(dec) == x && x.digitCount() == (int)dec.size(), std::to_string(n) + "-limb decimal round trip");
+    expect(BigInt::fromHex(x.toHex()) == x, std::to_string(n) + "-limb hex round trip");
+    expect(BigInt::fromBytes(x.toBytes()) == x && BigInt::fromBytes(x.toBytes(8 * n + 3, true), true) == x,
+           std::to_string(n) + "-limb byte round trip");
+  }
+}
+
+// info: a = q * b + r with |r| < |b| and r taking the sign of a (truncating division), and the
+//       operators agree with divmod
+static void checkQuotient(const BigInt& a, const BigInt& b, const std::string& what) {
+  BigInt q, r;
+  divmod(a, b, q, r);
+  bool ok = schoolbook(q, b) + r == a && BigInt::cmpAbs(r.a, b.a) < 0 && (r.isZero() || r.sign == a.sign);
+  expect(ok && a / b == q && a % b == r, what);
+}
+
+// divisor sizes around BURNIKEL_ZIEGLER_THRESHOLD, dividends from the same size to hundreds of limbs longer
+static void checkDivision() {
+  const int t = BigInt::BURNIKEL_ZIEGLER_THRESHOLD;
+  const size_t divisors[] = { 1, 2, 3, 17, (size_t)t / 2, (size_t)t - 2, (size_t)t - 1, (size_t)t, (size_t)t + 1,
+                              (size_t)t + 2, 2 * (size_t)t, 2 * (size_t)t + 1, 5 * (size_t)t + 3 };
+  const size_t extras[] = { 0, 1, 2, (size_t)t / 2 - 1, (size_t)t / 2, (size_t)t, (size_t)t + 1, 300, 700 };
+  for (size_t yn : divisors) {
+    for (size_t extra : extras) {
+      for (int kind = 0; kind < 4; kind++) {
+        bool ones = kind == 1;
+        BigInt a = operand(yn + extra, ones), b = operand(yn, ones || kind == 2);
+        if (kind == 3) {   // signs, and a dividend that is a multiple of the divisor plus a small rest
+          a = schoolbook(b, operand(extra + 1)) + BigInt(7);
+          a.sign = -1;
+        }
+        checkQuotient(a, b, "divmod of " + std::to_string(yn + extra) + " by " + std::to_string(yn) + " limbs");
+        BigInt nb = -b;
+        checkQuotient(a, nb, "divmod by a negative " + std::to_string(yn) + "-limb divisor");
+      }
+    }
+    checkQuotient(operand(yn / 2 + 1), operand(yn + 1), "divmod of a shorter dividend");
+  }
+}
+
+// Barrett reduction against %, for products of residues and for values that take the fallback
+static void checkBarrett() {
+  const size_t sizes[] = { 1, 2, 5, 40, 79, 80, 81, 120 };
+  for (size_t k : sizes) {
+    for (int ones = 0; ones < 2; ones++) {
+      BigInt m = operand(k, ones);
+      if (ones)
+        m -= BigInt(2);
+      Barrett barrett(m);
+      for (int i = 0; i < 20; i++) {
+        BigInt x = i < 10 ? schoolbook(operand(k) % m, operand(k) % m) : operand(k + i, ones);
+        if (i % 3 == 0)
+          x.sign = -1;
+        BigInt want = x % m;
+        if (want.sign < 0)
+          want += m;
+        expect(barrett.mod(x) == want, "barrett reduction by a " + std::to_string(k) + "-limb modulus");
+      }
+    }
+  }
+}
+
+// modInverse against known values, and a * inverse = 1 for random ones
+static void checkModInverse() {
+  BigInt m127 = (BigInt(1) << 127) - BigInt(1), m521 = (BigInt(1) << 521) - BigInt(1);
+  expect(modInverse(BigInt(65537), m127) == BigInt("5192217631581220737344928932233215"),
+         "65537^-1 mod 2^127 - 1");
+  expect(modInverse(BigInt::fromHex("1fd5863c3eb0469ec21a937a76f3432ffd73d97e447606b683ecf6f6e4a7ae225bfaff1eaaf8b0a1"), m521)
+         == BigInt::fromHex("1295032dce90b32aaaae50764394ae52acbf222270bb80c71bdf530cd5e5343fa9ecf9ba6cc1c4a69229d82904"
+                            "fbb068f97b320d5142d80ecd3140833d1121e0cab"),
+         "3^200^-1 mod 2^521 - 1");
+  expect(modInverse(BigInt(3), BigInt(11)) == BigInt(4), "3^-1 mod 11");
+  for (size_t n : { 1, 2, 8, 31, 64 }) {
+    for (int i = 0; i < 10; i++) {
+      BigInt m = operand(n);
+      m.a[0] |= 1;
+      BigInt a = operand(n) % m;
+      if (gcd(a, m) != BigInt(1))
+        continue;
+      BigInt inv = modInverse(a, m);
+      expect(inv.sign > 0 && inv < m && schoolbook(a, inv) % m == BigInt(1),
+             "modInverse for a " + std::to_string(n) + "-limb modulus");
+    }
+  }
+}
+
+int main() {
+  checkBasecaseKernels();
+  std::cout << "basecase kernels checked" << std::endl;
+  checkMultiplication();
+  std::cout << "multiplication checked" << std::endl;
+  checkConversions();
+  std::cout << "conversions checked" << std::endl;
+  checkDivision();
+  std::cout << "division checked" << std::endl;
+  checkBarrett();
+  std::cout << "barrett checked" << std::endl;
+  checkModInverse();
+  std::cout << "modInverse checked" << std::endl;
+  return failures ? 1 : 0;
+}
@@ -3,7 +3,7 @@
 
 #include "RSA.cpp"
 
-const int MAX_PRIME_DIGITS = 300;
+const int MAX_PRIME_DIGITS = 1000;
 const int MIN_PRIME_DIGITS = 3;
 
 int main() {
@@ -25,7 +25,8 @@ int main() {
     std::cout << "Please choose from the following:\n";
     std::cout << "1: Encrypt and decrypt a message.\n";
     std::cout << "2: Encrypt and decrypt a plaintext file.\n";
-    std::cout << "3: Quit\n";
+    std::cout << "3: Tune BigInt multiplication for this machine.\n";
+    std::cout << "4: Quit\n";
     std::cin >> choice;
     switch (choice) {
       case (1): {
@@ -54,6 +55,14 @@ int main() {
         continue;
       }
       case (3) : {
+        BigInt::MulThresholds thresholds = BigInt::tuneMultiplication();
+        std::cout << "Karatsuba from " << thresholds.karatsuba << " limbs (squares from " << thresholds.karatsuba_square
+                  << "), Toom-3 from " << thresholds.toom3
+                  << " limbs, NTT from " << thresholds.ntt << " limbs, " << thresholds.kernel->name
+                  << " basecase kernel.\n";
+        continue;
+      }
+      case (4) : {
         std::cout << "Terminating program.\n";
         break;
       }